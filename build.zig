@@ -22,10 +22,30 @@ pub fn build(b: *std.Build) !void {
         exe.addIncludePath(b.path(item));
     }
 
-    try addSources("./src", b, exe);
+    try addSources("./src", b, exe, null, &.{});
 
     b.installArtifact(exe);
 
+    // the standalone NNUE trainer, the engine sources without the engine entry point
+    const trainer = b.addExecutable(.{
+        .name = "tensiontrain",
+        .root_source_file = null,
+        .target = target,
+        .optimize = optimize,
+    });
+
+    trainer.linkLibCpp();
+
+    for (explicitIncludeDirs) |item| {
+        trainer.addIncludePath(b.path(item));
+    }
+
+    try addSources("./src", b, trainer, "main.cc", &trainerFlags);
+    try addSources("./train", b, trainer, null, &trainerFlags);
+
+    const train_step = b.step("trainer", "Build the NNUE trainer");
+    train_step.dependOn(&b.addInstallArtifact(trainer, .{}).step);
+
     // This *creates* a Run step in the build graph, to be executed when another
     // step is evaluated that depends on it. The next line below will establish
     // such a dependency.
@@ -40,6 +60,16 @@ pub fn build(b: *std.Build) !void {
 
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
+
+    // the fixed depth search of the bench suite, its node count is the signature of the engine
+    const bench_cmd = b.addRunArtifact(exe);
+    bench_cmd.addArg("bench");
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Run the bench suite");
+    bench_step.dependOn(&bench_cmd.step);
 }
 
 const explicitIncludeDirs = [_][]const u8 {
@@ -66,12 +96,18 @@ const standardFlags = [_][]const u8 {
     "-Wl,-stack_size", "-Wl,0x1000000"
 };
 
+// training is far too slow without optimizations
+const trainerFlags = [_][]const u8 {
+    "-O3"
+};
+
 const linkerFlags = [_][]const u8 {
 
 };
 
-/// Add all source files from the given directory to the compilation step
-pub fn addSources(directory: []const u8, b: *std.Build, c: *std.Build.Step.Compile) !void {
+/// Add all source files from the given directory to the compilation step, except the one at the
+/// given path relative to the directory, each compiled with the standard and the given extra flags
+pub fn addSources(directory: []const u8, b: *std.Build, c: *std.Build.Step.Compile, exclude: ?[]const u8, extraFlags: []const []const u8) !void {
     var dir = try std.fs.cwd().openDir(directory, .{ .iterate = true });
     var walker = try dir.walk(b.allocator);
     defer walker.deinit();
@@ -89,13 +125,15 @@ pub fn addSources(directory: []const u8, b: *std.Build, c: *std.Build.Step.Compi
         } else false;
 
         // add source file
-        if (inclAsSourceFile) {
+        const excluded = if (exclude) |path| std.mem.eql(u8, entry.path, path) else false;
+        if (inclAsSourceFile and !excluded) {
             // build flags
             var flags: std.ArrayList([]const u8) = std.ArrayList([]const u8).init(b.allocator);
             try flags.appendSlice(&standardFlags);
+            try flags.appendSlice(extraFlags);
 
             // add source file
-            c.addCSourceFile(.{ .file = b.path(try std.fs.path.resolve(b.allocator, &.{ "src", entry.path })), .flags = try flags.toOwnedSlice()});
+            c.addCSourceFile(.{ .file = b.path(try std.fs.path.resolve(b.allocator, &.{ directory, entry.path })), .flags = try flags.toOwnedSlice()});
             defer flags.deinit();
         }
     }
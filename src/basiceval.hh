@@ -1,32 +1,148 @@
 #pragma once
 
 #include "search.hh"
+#include "material.hh"
+#include "composedeval.hh"
 
 namespace tc {
 
-template<Color color>
-forceinline i32 count_material_eval(Board* b) {
-    i32 count = 0;
-    count += _popcount64(b->pieces(color, PAWN)) * evalValuePawn;
-    count += _popcount64(b->pieces(color, KNIGHT)) * evalValueKnight;
-    count += _popcount64(b->pieces(color, BISHOP)) * evalValueBishop;
-    count += _popcount64(b->pieces(color, ROOK)) * evalValueRook;
-    count += _popcount64(b->pieces(color, QUEEN)) * evalValueQueen;
-    return count;
+/* Terms */
+
+/// @brief Probes the material table, finishes the evaluation for trivially decided endgames.
+struct MaterialTerm : EvalTerm<MaterialTerm> {
+    MaterialTable<13> materialTable;
+
+    forceinline void evaluate(EvalContext* ctx) {
+        MaterialEntry* material = materialTable.probe(ctx->board);
+        if (material->has_eval_func()) {
+            ctx->finish(material->eval(ctx->board));
+            return;
+        }
+
+        ctx->value += material->imbalance;
+    }
+};
+
+/// @brief The piece-square score incrementally maintained by the board.
+struct PSTTerm : EvalTerm<PSTTerm> {
+    forceinline void evaluate(EvalContext* ctx) {
+        ctx->score += ctx->board->psq_score();
+    }
+};
+
+/// @brief Doubled, isolated and passed pawns.
+struct PawnTerm : EvalTerm<PawnTerm> {
+    forceinline void evaluate(EvalContext* ctx) {
+        Board* board = ctx->board;
+
+        Score score = 0;
+        for (Color color : { WHITE, BLACK }) {
+            const Bitboard pawns = board->pieces(color, PAWN);
+            const Bitboard enemyPawns = board->pieces(!color, PAWN);
+
+            Score sideScore = 0;
+            for (u8 file = 0; file < 8; file++) {
+                const u8 count = _popcount64(pawns & BITBOARD_FILE_MASK(file));
+                if (count == 0) {
+                    continue;
+                }
+
+                const Bitboard adjacentFiles = (file > 0 ? BITBOARD_FILE_MASK(file - 1) : 0) | (file < 7 ? BITBOARD_FILE_MASK(file + 1) : 0);
+                sideScore += doubledPawnWeight * (count - 1);
+                if ((pawns & adjacentFiles) == 0) {
+                    sideScore += isolatedPawnWeight * count;
+                }
+            }
+
+            Bitboard bb = pawns;
+            while (bb) {
+                const Sq sq = _pop_lsb(bb);
+                const u8 file = FILE(sq);
+                const Bitboard files = BITBOARD_FILE_MASK(file) | (file > 0 ? BITBOARD_FILE_MASK(file - 1) : 0) | (file < 7 ? BITBOARD_FILE_MASK(file + 1) : 0);
+                const Bitboard ahead = color ? (BITBOARD_FULL_MASK << 8 << (RANK(sq) * 8)) : ((1ULL << (RANK(sq) * 8)) - 1);
+                if ((enemyPawns & files & ahead) == 0) {
+                    sideScore += passedPawnWeightPerRank[color ? RANK(sq) : 7 - RANK(sq)];
+                }
+            }
+
+            score += SIGN_OF_COLOR(color) * sideScore;
+        }
+
+        ctx->score += score * iEval(0.01);
+    }
+};
+
+/// @brief The bound in centipawns of the given phase of the mobility score, with the pieces of a side without
+/// promotions all attacking as many squares as possible and all pieces of the other side hanging.
+constexpr i32 mobility_bound(i32 (*value)(Score)) {
+    constexpr i32 pieceCount[] = { 0, 2, 2, 2, 1, 0 };
+    constexpr i32 maxMobility[] = { 0, 8, 13, 14, 27, 0 };
+
+    i32 sideMax = 0, sideMin = 0;
+    for (u8 pt = KNIGHT; pt <= QUEEN; pt++) {
+        const i32 weight = value(mobilityWeightPerType[pt]) * pieceCount[pt] * maxMobility[pt];
+        sideMax += MAX(weight, 0);
+        sideMin += MIN(weight, 0);
+    }
+
+    const i32 hanging = value(hangingPieceWeight) * 7;
+    sideMax += MAX(hanging, 0);
+    sideMin += MIN(hanging, 0);
+    return sideMax - sideMin;
 }
 
-/// @brief Basic, classic static evaluation.
-struct BasicStaticEvaluator {
-    inline i32 eval(Board* board) {
+/// @brief Safe mobility and hanging pieces from the attack map.
+struct MobilityTerm : EvalTerm<MobilityTerm, /* expensive */ true> {
+    // promoted pieces could exceed the bound, the score is capped to it
+    static constexpr i32 maxCentipawns = MAX(mobility_bound(mg_value), mobility_bound(eg_value));
+    static constexpr i32 maxMagnitude = maxCentipawns * iEval(0.01);
+
+    forceinline void evaluate(EvalContext* ctx) {
+        Board* board = ctx->board;
+        const AttackMap* attacks = board->attack_map();
+
+        Score score = 0;
+        for (Color color : { WHITE, BLACK }) {
+            Score sideScore = 0;
+            for (u8 pt = KNIGHT; pt <= QUEEN; pt++) {
+                sideScore += mobilityWeightPerType[pt] * attacks->mobility[color][pt];
+            }
+
+            const Bitboard hanging = board->pieces(color, KNIGHT, BISHOP, ROOK, QUEEN) & attacks->all[!color] & ~attacks->all[color];
+            sideScore += hangingPieceWeight * _popcount64(hanging);
+
+            score += SIGN_OF_COLOR(color) * sideScore;
+        }
+
+        score = make_score(std::clamp(mg_value(score), -maxCentipawns, maxCentipawns), std::clamp(eg_value(score), -maxCentipawns, maxCentipawns));
+        ctx->score += score * iEval(0.01);
+    }
+};
+
+/// @brief The danger to both kings from attacks on their king zone, only applied in
+/// the middlegame and only once at least two pieces take part in the attack.
+struct KingSafetyTerm : EvalTerm<KingSafetyTerm, /* expensive */ true> {
+    // the danger of each side is capped, they are subtracted from each other and only tapered in
+    static constexpr i32 maxMagnitude = 500 * iEval(0.01);
+
+    forceinline void evaluate(EvalContext* ctx) {
+        const AttackMap* attacks = ctx->board->attack_map();
+
         i32 score = 0;
+        for (Color color : { WHITE, BLACK }) {
+            if (attacks->kingAttackersCount[!color] < 2) {
+                continue;
+            }
 
-        // count material score
-        score += count_material_eval<WHITE>(board) - count_material_eval<BLACK>(board);
+            const i32 danger = attacks->kingAttackersWeight[!color] * 8 + attacks->kingZoneAttacks[!color] * 6;
+            score -= SIGN_OF_COLOR(color) * MIN(danger * danger / 128, 500);
+        }
 
-        // score pawn structure
-        
-        return score;
+        ctx->score += make_score(score * iEval(0.01), 0);
     }
 };
 
+/// @brief Basic, classic static evaluation.
+struct BasicStaticEvaluator : ComposedEvaluator<MaterialTerm, PSTTerm, PawnTerm, MobilityTerm, KingSafetyTerm> { };
+
 }
\ No newline at end of file
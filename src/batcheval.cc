@@ -0,0 +1,133 @@
+#include "batcheval.hh"
+#include "material.hh"
+#include "pst.hh"
+
+namespace tc::batch {
+
+// the feature index of empty slots, a piece value no real piece has so all its weights are zero
+#define NULL_FEATURE (NULL_PIECE * 64)
+
+/// @brief The linear weights per feature (piece * 64 + square) split into one table per term,
+/// so each can be gathered with 32 bit indices.
+struct PrecalcLinearWeights {
+    alignas(32) i32 mg[32 * 64];
+    alignas(32) i32 eg[32 * 64];
+    alignas(32) i32 material[32 * 64];
+
+    PrecalcLinearWeights() : mg(), eg(), material() {
+        static const i32 valuePerType[] = { evalValuePawn, evalValueKnight, evalValueBishop, evalValueRook, evalValueQueen, 0 };
+        for (u8 pt = PAWN; pt <= KING; pt++) {
+            for (Color color : { WHITE, BLACK }) {
+                const Piece p = pt | PIECE_COLOR_FOR(color);
+                for (Sq sq = 0; sq < 64; sq++) {
+                    const Score score = pst::piece_square_score(p, sq);
+                    mg[p * 64 + sq] = mg_value(score);
+                    eg[p * 64 + sq] = eg_value(score);
+                    material[p * 64 + sq] = SIGN_OF_COLOR(color) * valuePerType[pt];
+                }
+            }
+        }
+    }
+};
+
+// built on first use, as the piece-square tables are initialized in another translation unit
+static const PrecalcLinearWeights& linear_weights() {
+    static const PrecalcLinearWeights weights;
+    return weights;
+}
+
+// evaluate up to BATCH_LANES positions, transposed into one lane each
+static void eval_linear_block(const PrecalcLinearWeights& weights, const PackedPosition* positions, u32 n, i32* out) {
+    alignas(32) i32 features[BATCH_MAX_PIECES][BATCH_LANES];
+    alignas(32) i32 phase[BATCH_LANES];
+    alignas(32) i32 bishopPair[BATCH_LANES];
+
+    u32 maxPieces = 0;
+    for (u32 lane = 0; lane < BATCH_LANES; lane++) {
+        u32 count = 0;
+        u8 bishops[2] = { 0, 0 };
+        phase[lane] = 0;
+        if (lane < n) {
+            positions[lane].for_each_piece([&](Piece p, Sq sq) {
+                features[count++][lane] = p * 64 + sq;
+                phase[lane] += phaseWeightPerType[TYPE_OF_PIECE(p)];
+                bishops[IS_WHITE_PIECE(p)] += TYPE_OF_PIECE(p) == BISHOP;
+            });
+        }
+
+        phase[lane] = MIN(phase[lane], PHASE_MAX);
+        bishopPair[lane] = (bishops[WHITE] >= 2) * evalBishopPair - (bishops[BLACK] >= 2) * evalBishopPair;
+        maxPieces = MAX(maxPieces, count);
+        for (; count < BATCH_MAX_PIECES; count++) {
+            features[count][lane] = NULL_FEATURE;
+        }
+    }
+
+#ifdef __AVX2__
+    __m256i mg = _mm256_setzero_si256();
+    __m256i eg = _mm256_setzero_si256();
+    __m256i material = _mm256_load_si256((const __m256i*)bishopPair);
+    for (u32 i = 0; i < maxPieces; i++) {
+        const __m256i idx = _mm256_load_si256((const __m256i*)features[i]);
+        mg = _mm256_add_epi32(mg, _mm256_i32gather_epi32(weights.mg, idx, 4));
+        eg = _mm256_add_epi32(eg, _mm256_i32gather_epi32(weights.eg, idx, 4));
+        material = _mm256_add_epi32(material, _mm256_i32gather_epi32(weights.material, idx, 4));
+    }
+
+    // taper, the division is done in float which is exact for the magnitudes of the scores
+    const __m256i ph = _mm256_load_si256((const __m256i*)phase);
+    const __m256i mixed = _mm256_add_epi32(_mm256_mullo_epi32(mg, ph), _mm256_mullo_epi32(eg, _mm256_sub_epi32(_mm256_set1_epi32(PHASE_MAX), ph)));
+    const __m256i tapered = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(mixed), _mm256_set1_ps(PHASE_MAX)));
+
+    alignas(32) i32 results[BATCH_LANES];
+    _mm256_store_si256((__m256i*)results, _mm256_add_epi32(tapered, material));
+#else
+    i32 results[BATCH_LANES];
+    for (u32 lane = 0; lane < BATCH_LANES; lane++) {
+        i32 mg = 0, eg = 0, material = bishopPair[lane];
+        for (u32 i = 0; i < maxPieces; i++) {
+            mg += weights.mg[features[i][lane]];
+            eg += weights.eg[features[i][lane]];
+            material += weights.material[features[i][lane]];
+        }
+
+        results[lane] = (mg * phase[lane] + eg * (PHASE_MAX - phase[lane])) / PHASE_MAX + material;
+    }
+#endif
+
+    memcpy(out, results, n * sizeof(i32));
+}
+
+void eval_linear(const PackedPosition* positions, u64 count, i32* out, u32 threads) {
+    const PrecalcLinearWeights& weights = linear_weights();
+    parallel_for(count, threads, BATCH_CHUNK_SIZE, [&](u64 begin, u64 end) {
+        for (u64 i = begin; i < end; i += BATCH_LANES) {
+            eval_linear_block(weights, positions + i, MIN(end - i, (u64)BATCH_LANES), out + i);
+        }
+    });
+}
+
+void eval_nnue(const nnue::Network* network, const PackedPosition* positions, u64 count, i32* out, u32 threads) {
+    parallel_for(count, threads, BATCH_CHUNK_SIZE, [&](u64 begin, u64 end) {
+        nnue::Accumulator* acc = (nnue::Accumulator*)_mm_malloc(sizeof(nnue::Accumulator), alignof(nnue::Accumulator));
+        const i16* columns[BATCH_MAX_PIECES];
+        for (u64 i = begin; i < end; i++) {
+            const PackedPosition& position = positions[i];
+            for (Color perspective : { WHITE, BLACK }) {
+                u8 n = 0;
+                position.for_each_piece([&](Piece p, Sq sq) {
+                    columns[n++] = network->ftWeights + nnue::feature_index(perspective, p, sq) * NNUE_HIDDEN_SIZE;
+                });
+
+                nnue::update_accumulator(network->ftBiases, acc->values[perspective], columns, n, nullptr, 0);
+            }
+
+            // the network is relative to the side to move
+            out[i] = SIGN_OF_COLOR(position.turn) * nnue::evaluate(network, acc, position.turn);
+        }
+
+        _mm_free(acc);
+    });
+}
+
+}
\ No newline at end of file
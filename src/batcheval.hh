@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "board.hh"
+#include "nnue.hh"
+#include "packedpos.hh"
+#include "util.hh"
+
+/*
+    Batched evaluation of many independent positions, for labelling and tuning data. The batches
+    are split into chunks evaluated in parallel, the per call overhead of the single position
+    evaluators is paid once per chunk instead.
+
+    The linear terms (material and piece-square tables) are evaluated in SIMD across positions on
+    a structure-of-arrays block of BATCH_LANES positions. The NNUE is vectorised across features
+    instead, each accumulator is built from all features of a position in a single pass. All
+    results are ABSOLUTE, like the single position evaluators.
+ */
+
+namespace tc::batch {
+
+#define BATCH_LANES      8    // positions per SIMD block, one per 32 bit lane
+#define BATCH_MAX_PIECES 32
+#define BATCH_CHUNK_SIZE 4096 // positions per chunk handed to a thread
+
+/// @brief Evaluate the material, bishop pair and piece-square terms of the given positions, which are
+/// the linear part of the basic static evaluation without any specialised endgame evaluation.
+void eval_linear(const PackedPosition* positions, u64 count, i32* out, u32 threads);
+
+/// @brief Evaluate the given positions by the NNUE.
+void eval_nnue(const nnue::Network* network, const PackedPosition* positions, u64 count, i32* out, u32 threads);
+
+/// @brief Evaluate the given positions with the full static evaluator, one evaluator and board per thread.
+template<typename _Evaluator>
+void eval_static(const PackedPosition* positions, u64 count, i32* out, u32 threads) {
+    parallel_for(count, threads, BATCH_CHUNK_SIZE, [&](u64 begin, u64 end) {
+        thread_local Board board;
+        thread_local _Evaluator evaluator;
+        for (u64 i = begin; i < end; i++) {
+            unpack_position(&positions[i], &board);
+            out[i] = evaluator.eval(&board);
+        }
+    });
+}
+
+/// @brief Evaluate the given boards with the full static evaluator, one evaluator per thread.
+template<typename _Evaluator>
+void eval_static(Board* const* boards, u64 count, i32* out, u32 threads) {
+    parallel_for(count, threads, BATCH_CHUNK_SIZE, [&](u64 begin, u64 end) {
+        thread_local _Evaluator evaluator;
+        for (u64 i = begin; i < end; i++) {
+            out[i] = evaluator.eval(boards[i]);
+        }
+    });
+}
+
+/// @brief Pack the given boards for the batch evaluators.
+inline void pack_boards(Board* const* boards, u64 count, PackedPosition* out, u32 threads) {
+    parallel_for(count, threads, BATCH_CHUNK_SIZE, [&](u64 begin, u64 end) {
+        for (u64 i = begin; i < end; i++) {
+            pack_position(boards[i], &out[i]);
+        }
+    });
+}
+
+inline void eval_linear(Board* const* boards, u64 count, i32* out, u32 threads) {
+    std::vector<PackedPosition> positions(count);
+    pack_boards(boards, count, positions.data(), threads);
+    eval_linear(positions.data(), count, out, threads);
+}
+
+inline void eval_nnue(const nnue::Network* network, Board* const* boards, u64 count, i32* out, u32 threads) {
+    std::vector<PackedPosition> positions(count);
+    pack_boards(boards, count, positions.data(), threads);
+    eval_nnue(network, positions.data(), count, out, threads);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "bitbase.hh"
+#include "lookup.hh"
+
+#include <vector>
+
+namespace tc::bitbase {
+
+// the classification of a position during generation, combined as flags
+// so the successors of a position can be or'd together
+enum KPKResult : u8 {
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1 << 0,
+    KPK_DRAW    = 1 << 1,
+    KPK_WIN     = 1 << 2
+};
+
+// decode a position index into its squares
+static void decode(u32 idx, Color* stm, Sq* strongKing, Sq* strongPawn, Sq* weakKing) {
+    *stm = idx & 1;
+    *weakKing = (idx >> 1) & 63;
+    *strongKing = (idx >> 7) & 63;
+    const u32 pawnIndex = idx >> 13;
+    *strongPawn = INDEX(pawnIndex / 6, pawnIndex % 6 + 1);
+}
+
+// classify the position without looking at successors
+static KPKResult classify_initial(u32 idx) {
+    Color stm; Sq wk, wp, bk;
+    decode(idx, &stm, &wk, &wp, &bk);
+
+    const Bitboard pawnAttacks = lookup::pawnAttackBBs.values[WHITE][wp];
+    const Sq pushSq = wp + 8;
+
+    // overlapping or adjacent kings, or the weak king in check with white to move
+    if (lookup::squareDistance.values[wk][bk] <= 1 || wk == wp || bk == wp ||
+        (stm == WHITE && (pawnAttacks & (1ULL << bk)))) {
+        return KPK_INVALID;
+    }
+
+    // the pawn promotes without being captured
+    if (stm == WHITE && RANK(wp) == 6 && wk != pushSq && bk != pushSq &&
+        (lookup::squareDistance.values[bk][pushSq] > 1 || lookup::squareDistance.values[wk][pushSq] == 1)) {
+        return KPK_WIN;
+    }
+
+    // the weak king is stalemated or can capture the undefended pawn
+    const Bitboard weakKingMoves = lookup::kingMovementBBs.values[bk];
+    const Bitboard strongKingAttacks = lookup::kingMovementBBs.values[wk];
+    if (stm == BLACK && ((weakKingMoves & ~(strongKingAttacks | pawnAttacks)) == 0 ||
+                         (weakKingMoves & ~strongKingAttacks & (1ULL << wp)))) {
+        return KPK_DRAW;
+    }
+
+    return KPK_UNKNOWN;
+}
+
+// classify the position from the results of its successors
+static KPKResult classify(std::vector<KPKResult>& db, u32 idx) {
+    Color stm; Sq wk, wp, bk;
+    decode(idx, &stm, &wk, &wp, &bk);
+
+    const KPKResult good = stm == WHITE ? KPK_WIN : KPK_DRAW;
+    const KPKResult bad = stm == WHITE ? KPK_DRAW : KPK_WIN;
+
+    // invalid successors are zero and do not contribute
+    u8 r = KPK_INVALID;
+    Bitboard moves = lookup::kingMovementBBs.values[stm == WHITE ? wk : bk];
+    while (moves) {
+        const Sq dst = _pop_lsb(moves);
+        r |= stm == WHITE ? db[PrecalcKPKBitbase::index(BLACK, dst, wp, bk)]
+                          : db[PrecalcKPKBitbase::index(WHITE, wk, wp, dst)];
+    }
+
+    if (stm == WHITE) {
+        // single push, promotion is already classified initially
+        if (RANK(wp) < 6) {
+            r |= db[PrecalcKPKBitbase::index(BLACK, wk, wp + 8, bk)];
+        }
+
+        // double push
+        if (RANK(wp) == 1 && wp + 8 != wk && wp + 8 != bk) {
+            r |= db[PrecalcKPKBitbase::index(BLACK, wk, wp + 16, bk)];
+        }
+    }
+
+    return (r & good) ? good : (r & KPK_UNKNOWN) ? KPK_UNKNOWN : bad;
+}
+
+PrecalcKPKBitbase::PrecalcKPKBitbase() : values() {
+    std::vector<KPKResult> db(KPK_SIZE);
+    for (u32 idx = 0; idx < KPK_SIZE; idx++) {
+        db[idx] = classify_initial(idx);
+    }
+
+    // iterate until no unknown position can be resolved anymore
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 idx = 0; idx < KPK_SIZE; idx++) {
+            if (db[idx] == KPK_UNKNOWN && (db[idx] = classify(db, idx)) != KPK_UNKNOWN) {
+                changed = true;
+            }
+        }
+    }
+
+    // remaining unknown positions are draws
+    for (u32 idx = 0; idx < KPK_SIZE; idx++) {
+        if (db[idx] == KPK_WIN) {
+            values[idx >> 5] |= 1U << (idx & 31);
+        }
+    }
+}
+
+extern const PrecalcKPKBitbase kpkBitbase { };
+
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.hh"
+#include "platform.hh"
+
+/*
+    KPK win/draw bitbase, generated by retrograde analysis at program start. Positions are
+    normalized so the strong side is white and the pawn is on the files A to D, one bit per
+    position: 24 pawn squares * 64 * 64 king squares * 2 sides to move = 24 KB.
+ */
+
+namespace tc::bitbase {
+
+#define KPK_SIZE (24 * 64 * 64 * 2)
+
+/// @brief The KPK bitbase, a set bit meaning the position is won for the strong side.
+struct PrecalcKPKBitbase {
+    u32 values[KPK_SIZE / 32];
+
+    PrecalcKPKBitbase();
+
+    /// @brief The index of the normalized position, the pawn has to be on the files A to D.
+    static forceinline u32 index(Color stm, Sq strongKing, Sq strongPawn, Sq weakKing) {
+        return (((FILE(strongPawn) * 6 + (RANK(strongPawn) - 1)) * 64 + strongKing) * 64 + weakKing) * 2 + stm;
+    }
+
+    forceinline bool is_win(u32 idx) const { return values[idx >> 5] & (1U << (idx & 31)); }
+};
+
+extern const PrecalcKPKBitbase kpkBitbase;
+
+/// @brief Probe the KPK bitbase with the strong side as white, returns whether the position is won.
+/// The squares do not have to be normalized horizontally.
+forceinline bool probe_kpk(Sq strongKing, Sq strongPawn, Sq weakKing, Color stm) {
+    // mirror the pawn onto the files A to D
+    if (FILE(strongPawn) > 3) {
+        strongKing ^= 7;
+        strongPawn ^= 7;
+        weakKing ^= 7;
+    }
+
+    return kpkBitbase.is_win(PrecalcKPKBitbase::index(stm, strongKing, strongPawn, weakKing));
+}
+
+}
\ No newline at end of file
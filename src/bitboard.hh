@@ -26,7 +26,7 @@ typedef u64 Bitboard;
 #define BITBOARD_RANK_MASK(rank) (BITBOARD_RANK0_MASK << (rank * 8))
 #define BITBOARD_FILE_MASK(file) (BITBOARD_FILE0_MASK << (file))
 
-#define BB_FILES_17_MASK (0x9F'9F'9F'9F'9F'9F'9F'9FULL) // Files 1 to 7, allows movement to the right by one square
+#define BB_FILES_17_MASK (0x7F'7F'7F'7F'7F'7F'7F'7FULL) // Files 1 to 7, allows movement to the right by one square
 #define BB_FILES_28_MASK (0xFE'FE'FE'FE'FE'FE'FE'FEULL) // Files 2 to 8, allows movement to the left by one square
 
 /* Block Masks [INCLUSIVE] */
@@ -38,6 +38,7 @@ typedef u64 Bitboard;
 /* Chess Bitboards */
 #define BB_2_OR_7_RANK (0x00'FF'00'00'00'00'FF'00ULL)
 #define BB_1_OR_8_RANK (0xFF'00'00'00'00'00'00'FFULL)
+#define BB_DARK_SQUARES (0xAA'55'AA'55'AA'55'AA'55ULL)
 
 /* Precomputed lines on bitboards between 2 squares */
 extern Bitboard betweenBBsExcl[64][64];
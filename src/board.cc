@@ -1,20 +1,15 @@
 #include "board.hh"
 
-#include <sys/time.h>
 #include <random>
+#include <algorithm>
 #include "util.hh"
 
 namespace tc {
 
-static u64 seedrng() {
-    // seed the random number gen
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    u64 seed = tv.tv_sec * 1000ULL + (tv.tv_usec);
-    srand(seed);
-    log<DEBUG>(P, "Zhash rng seed: %llu", seed);
-    return seed;
-}
+#define ZOBRIST_SEED 0x7E45104C4E55ULL // fixed so the keys, and with them the bench node counts, are the same on every run
+
+// the hash bits have to be uniformly distributed, the cuckoo table indexes by plain bit ranges of the keys
+static std::mt19937_64 zobristRng(ZOBRIST_SEED);
 
 template<int arraySize>
 static const PositionHashArray<arraySize> init_zarray() {
@@ -22,20 +17,61 @@ static const PositionHashArray<arraySize> init_zarray() {
 
     // generate random number for each index
     for (int i = 0; i < array.size(); i++) {
-        u64 r = ((u64)rand() | ((u64)rand() << 32) | ((u64)rand() << 16) | ((u64)rand() << 48));  
-        array[i] = r;
+        array[i] = zobristRng();
     }
 
     return array;
 }
 
-static u64 __seed = seedrng();
-
 extern const PositionHashArray<1 << 12> pieceSqHashes = init_zarray<1 << 12>();
 extern const PositionHashArray<256> enPassantSqHashes = init_zarray<256>();
 
 extern const PositionHashArray<2> sideToMoveHashes = init_zarray<2>();
 
+extern const PositionHashArray<1 << 9> materialHashes = init_zarray<1 << 9>();
+
+// defined after the hashes it is computed from, which are initialized in order within this file
+PrecalcCuckooTable::PrecalcCuckooTable() : keys(), moves() {
+    for (u8 i = 0; i < 10; i++) {
+        const PieceType type = (PieceType)(KNIGHT + i % 5);
+        const Piece piece = type | PIECE_COLOR_FOR(i >= 5);
+        for (Sq src = 0; src < 64; src++) {
+            for (Sq dst = src + 1; dst < 64; dst++) {
+                const i32 df = std::abs(FILE(src) - FILE(dst));
+                const i32 dr = std::abs(RANK(src) - RANK(dst));
+                const bool diagonal = df == dr;
+                const bool straight = df == 0 || dr == 0;
+                const bool reachable = (type == KNIGHT && ((df == 1 && dr == 2) || (df == 2 && dr == 1))) ||
+                                       (type == BISHOP && diagonal) ||
+                                       (type == ROOK && straight) ||
+                                       (type == QUEEN && (diagonal || straight)) ||
+                                       (type == KING && MAX(df, dr) == 1);
+                if (!reachable) {
+                    continue;
+                }
+
+                PositionHash key = pieceSqHashes[PIECE_HASH_KEY(piece, src)] ^ pieceSqHashes[PIECE_HASH_KEY(piece, dst)] ^
+                                   sideToMoveHashes[WHITE] ^ sideToMoveHashes[BLACK];
+                Move move = Move::make(src, dst);
+
+                // insert by displacing the entry in the way to its other slot until an empty slot is found
+                u32 j = CUCKOO_H1(key);
+                while (true) {
+                    std::swap(keys[j], key);
+                    std::swap(moves[j], move);
+                    if (move.null()) {
+                        break;
+                    }
+
+                    j = j == CUCKOO_H1(key) ? CUCKOO_H2(key) : CUCKOO_H1(key);
+                }
+            }
+        }
+    }
+}
+
+extern const PrecalcCuckooTable cuckooTable { };
+
 Board::Board() {
     // init bitboards to 0 idk if this is needed tbh
     memset(&pieceArray, NULL_PIECE, 64);
@@ -44,118 +80,198 @@ Board::Board() {
     allPieces = 0;
 }
 
-void Board::load_fen(const char* cstr) {
-    if (strcmp(cstr, "startpos") == 0) {
-        load_fen(startFEN);
-        return;
+// the piece per fen character, NULL_PIECE for characters which are no piece
+static const std::array<Piece, 128> fenCharToPiece = []() {
+    std::array<Piece, 128> table;
+    table.fill(NULL_PIECE);
+    for (u8 type = PAWN; type <= KING; type++) {
+        table[(u8)typeToCharLowercase[type]] = type | BLACK_PIECE;
+        table[(u8)(typeToCharLowercase[type] - 'a' + 'A')] = type | WHITE_PIECE;
     }
 
-    std::string str(cstr);
-    std::istringstream iss(str);
-    std::noskipws(iss);
-    std::istream_iterator<char> it(iss);
-    load_fen(it, std::istream_iterator<char>());
+    return table;
+}();
+
+static forceinline const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
 }
 
-void Board::load_fen(std::istream_iterator<char>& it, const std::istream_iterator<char>& end) {
-    skip_whitespace(it);
+// parse an unsigned number of at most 9 digits, returns nullptr if there is none
+static forceinline const char* parse_uint(const char* p, const char* end, u32* out) {
+    const char* begin = p;
+    u32 value = 0;
+    while (p < end && p - begin < 9 && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    *out = value;
+    return p > begin ? p : nullptr;
+}
 
-    if (*it == 's') {
-        load_fen(startFEN);
-        return;
+const char* Board::parse_fen(const char* p, const char* end) {
+    p = skip_blanks(p, end);
+    if (end - p >= 8 && memcmp(p, "startpos", 8) == 0) {
+        return parse_fen(startFEN, startFEN + strlen(startFEN)) ? p + 8 : nullptr;
     }
 
-    VolatileBoardState* state = volatile_state();
-
-    // parse piece placement
-    u8 rank = 7;
-    u8 file = 0;
-    while (*it != ' ' && it != end && (rank > 0 || file < 8)) {
-        if (*it == '/') {
+    // parse the piece placement from the 8th rank down, only written to the board once it is complete
+    Piece squares[64];
+    memset(squares, NULL_PIECE, sizeof(squares));
+    i32 rank = 7, file = 0;
+    u32 pieceCount = 0;
+    u8 kings[2] = { 0, 0 };
+    for (; p < end && *p != ' ' && *p != '\t'; p++) {
+        const char c = *p;
+        if (c == '/') {
+            if (file != 8 || rank == 0) return nullptr;
             rank--;
             file = 0;
-            it++;
             continue;
         }
 
-        // parse skip
-        if (isdigit(*it)) {
-            file += *it - '0';
-            it++;
+        if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) return nullptr;
             continue;
         }
 
-        // parse pieces
-        char pieceChar = *it;
-        u8 color = isupper(pieceChar) * WHITE_PIECE;
-        PieceType type = charToPieceType(pieceChar);
-        this->set_piece<false>(INDEX(file, rank), type | color);
-        file += 1;
-        it++;
-    }
+        const Piece piece = (u8)c < 128 ? fenCharToPiece[(u8)c] : NULL_PIECE;
+        if (piece == NULL_PIECE || file > 7) return nullptr;
 
-    it++;
-    if (it != end) {
-        // parse side to move
-        turn = tolower(*it) == 'w';
-        it++;
-    } else {
-        goto ret;
-    }
+        // pawns can never stand on the first or last rank
+        if (TYPE_OF_PIECE(piece) == PAWN && (rank == 0 || rank == 7)) return nullptr;
 
-    // parse castling rights
-    it++;
-    state->castlingStatus[BLACK] = state->castlingStatus[WHITE] = 0;
-    while (it != end && *it != '-' && *it != ' ') {
-        Color color = isupper(*it);
-        u8 flags = tolower(*it) == 'k' ? CAN_CASTLE_R : CAN_CASTLE_L;
-        state->castlingStatus[color] |= flags;
-        it++;
+        squares[INDEX(file, rank)] = piece;
+        kings[IS_WHITE_PIECE(piece)] += TYPE_OF_PIECE(piece) == KING;
+        pieceCount++;
+        file++;
     }
 
-    // parse en passant sq
-    it++;
-    if (it == end) {
-        goto ret;
+    if (rank != 0 || file != 8 || kings[WHITE] != 1 || kings[BLACK] != 1 || pieceCount > 32) {
+        return nullptr;
     }
 
-    if (*it == ' ') {
-        it++;
+    // parse the side to move
+    p = skip_blanks(p, end);
+    if (p == end || (*p != 'w' && *p != 'b') || (p + 1 < end && p[1] != ' ' && p[1] != '\t')) {
+        return nullptr;
     }
 
-    if (it != end) {
-        if (*it == '-') {
-            state->enPassantTarget = NULL_SQ;
-            it++;
-        } else {
-            char fileChar = *it;
-            it++;
-            char rankChar = *it;
-            state->enPassantTarget = INDEX(CHAR_TO_FILE(fileChar), CHAR_TO_RANK(rankChar));
-            it++; it++;
+    const Color sideToMove = *p++ == 'w';
+
+    // the remaining fields are optional, each is only taken if it is well formed, so an EPD
+    // line continues with its operations after the last field
+    u8 castlingStatus[2] = { 0, 0 };
+    Sq enPassantTarget = NULL_SQ;
+    u32 rule50Ply = 0, fullMoves = 1;
+
+    const char* q = skip_blanks(p, end);
+    const char* fieldEnd = q;
+    while (fieldEnd < end && *fieldEnd != ' ' && *fieldEnd != '\t') fieldEnd++;
+    if (fieldEnd - q == 1 && *q == '-') {
+        p = fieldEnd;
+    } else if (q < fieldEnd && std::all_of(q, fieldEnd, [](char c) { return c == 'K' || c == 'Q' || c == 'k' || c == 'q'; })) {
+        for (; q < fieldEnd; q++) {
+            castlingStatus[*q < 'a'] |= (*q == 'K' || *q == 'k') ? CAN_CASTLE_R : CAN_CASTLE_L;
         }
+
+        p = fieldEnd;
     } else {
-        goto ret;
+        goto apply;
     }
 
-    // parse halfmove clock
-    it++;
-    if (it != end) {
-        state->rule50Ply = parse_int(it, end);
+    q = skip_blanks(p, end);
+    if (q < end && *q == '-') {
+        p = q + 1;
+    } else if (end - q >= 2 && q[0] >= 'a' && q[0] <= 'h' && (q[1] == (sideToMove ? '6' : '3'))) {
+        enPassantTarget = INDEX(CHAR_TO_FILE(q[0]), CHAR_TO_RANK(q[1]));
+        p = q + 2;
     } else {
-        goto ret;
+        goto apply;
     }
 
-    // parse full move counter
-    it++;
-    if (it != end) {
-        ply = (parse_int(it, end) - 1) * 2;
-    } else {
-        goto ret;
+    q = skip_blanks(p, end);
+    if ((q = parse_uint(q, end, &rule50Ply))) {
+        p = q;
+        q = skip_blanks(p, end);
+        if ((q = parse_uint(q, end, &fullMoves))) {
+            p = q;
+        }
+    }
+
+apply:
+    // replace the position, the incremental keys and scores are rebuilt piece by piece
+    // while the attached accumulators are refreshed once at the end
+    nnue::AccumulatorStack* stack = accumulatorStack;
+    accumulatorStack = nullptr;
+
+    memset(pieceArray, NULL_PIECE, sizeof(pieceArray));
+    memset(pieceBBs, 0, sizeof(pieceBBs));
+    memset(allPiecesPerColor, 0, sizeof(allPiecesPerColor));
+    memset(pieceCounts, 0, sizeof(pieceCounts));
+    allPieces = 0;
+    phase = 0;
+    psqScore = 0;
+    pieceZHash = materialKey = pawnKey = 0;
+    kingIndexPerColor[WHITE] = kingIndexPerColor[BLACK] = NULL_SQ;
+
+    for (Sq sq = 0; sq < 64; sq++) {
+        if (squares[sq] != NULL_PIECE) {
+            set_piece<false>(sq, squares[sq]);
+        }
+    }
+
+    // castling rights are only kept while the king and the rook are on their squares
+    for (Color color : { WHITE, BLACK }) {
+        const u8 backRank = color == WHITE ? 0 : 7;
+        const Piece rook = ROOK | PIECE_COLOR_FOR(color);
+        if (squares[INDEX(4, backRank)] != (KING | PIECE_COLOR_FOR(color))) castlingStatus[color] = 0;
+        if (squares[INDEX(0, backRank)] != rook) castlingStatus[color] &= ~CAN_CASTLE_L;
+        if (squares[INDEX(7, backRank)] != rook) castlingStatus[color] &= ~CAN_CASTLE_R;
+    }
+
+    turn = sideToMove;
+    ply = (MAX(fullMoves, 1u) - 1) * 2;
+    VolatileBoardState* state = volatile_state();
+    state->rule50Ply = (u8)MIN(rule50Ply, 255u);
+    state->enPassantTarget = enPassantTarget;
+    state->castlingStatus[WHITE] = castlingStatus[WHITE];
+    state->castlingStatus[BLACK] = castlingStatus[BLACK];
+    recalculate_state();
+
+    if (stack) {
+        accumulatorStack = stack;
+        stack->refresh(this);
+    }
+
+    return p;
+}
+
+bool Board::load_fen(std::string_view fen) {
+    const char* end = fen.data() + fen.size();
+    const char* p = parse_fen(fen.data(), end);
+    return p != nullptr && skip_blanks(p, end) == end;
+}
+
+void Board::load_fen(const char* cstr) {
+    load_fen(std::string_view(cstr));
+}
+
+void Board::load_fen(std::istream_iterator<char>& it, const std::istream_iterator<char>& end) {
+    // collect the at most 6 fields of the fen, stopping in front of whatever follows
+    std::string fen;
+    u32 fields = 0;
+    while (it != end) {
+        const bool blank = *it == ' ' || *it == '\t';
+        if (!blank && (fen.empty() || fen.back() == ' ')) {
+            // startpos is a single field
+            if (fields == 6 || fen == "startpos ") break;
+            fields++;
+        }
+
+        if (!blank || (!fen.empty() && fen.back() != ' ')) fen += blank ? ' ' : *it;
+        it++;
     }
 
-ret:
-    this->recalculate_state();
+    load_fen(fen.c_str());
 }
 
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <array>
 #include <string>
+#include <string_view>
 #include <iterator>
 #include <sstream>
 
@@ -12,6 +13,8 @@
 #include "piece.hh"
 #include "move.hh"
 #include "lookup.hh"
+#include "pst.hh"
+#include "nnue.hh"
 
 namespace tc {
 
@@ -31,8 +34,45 @@ extern const PositionHash hashCanCastleR;
 
 extern const PositionHashArray<2> sideToMoveHashes;
 
+extern const PositionHashArray<1 << 9> materialHashes;
+
 // The hash key for a piece on the given square
 #define PIECE_HASH_KEY(piece, sq) ((i16)(piece | (sq << 5)))
+// The hash key for the n-th (zero based) piece of the given type and color on the board
+#define MATERIAL_HASH_KEY(piece, n) ((i16)(piece | (n << 5)))
+
+#define CUCKOO_SIZE 8192
+#define CUCKOO_H1(key) ((key) & (CUCKOO_SIZE - 1))
+#define CUCKOO_H2(key) (((key) >> 32) & (CUCKOO_SIZE - 1))
+
+/// @brief The hash difference of every reversible move, a non pawn piece moving between two squares it
+/// attacks on an empty board, stored by cuckoo hashing. Used to find moves repeating an earlier position
+/// through the key difference of the positions (Marcel van Kervinck's method).
+struct PrecalcCuckooTable {
+    PositionHash keys[CUCKOO_SIZE];
+    Move moves[CUCKOO_SIZE];
+
+    PrecalcCuckooTable();
+};
+
+extern const PrecalcCuckooTable cuckooTable;
+
+#define KEY_HISTORY_SIZE 256 // a power of 2 larger than the 50 move rule ply counter can get
+
+/// @brief The keys of the positions before each move made on the board it is attached to, in the
+/// order the moves were made. A ring buffer as only the positions since the last irreversible move,
+/// bounded by the 50 move rule, can be repeated.
+struct KeyHistory {
+    PositionHash keys[KEY_HISTORY_SIZE];
+    u32 count = 0;
+
+    forceinline void push(PositionHash key) { keys[count++ & (KEY_HISTORY_SIZE - 1)] = key; }
+    forceinline void pop() { count--; }
+    forceinline void clear() { count = 0; }
+
+    /// @brief The key of the position the given amount of plies (at least 1) before the current one.
+    forceinline PositionHash before(u32 plies) const { return keys[(count - plies) & (KEY_HISTORY_SIZE - 1)]; }
+};
 
 static const char* startFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
@@ -43,6 +83,42 @@ struct AttackInfo {
     Bitboard pinned;
 };
 
+/// @brief Attacks of all pieces on the board, computed at most once per piece placement
+/// and shared between move generation (king moves, castling) and evaluation.
+struct AttackMap {
+    /// @brief The piece placement hash this map was computed for
+    PositionHash key = 0;
+    bool valid = false;
+
+    /// @brief The squares attacked per piece type per color
+    Bitboard byType[2][PIECE_TYPE_COUNT];
+
+    /// @brief All squares attacked per color
+    Bitboard all[2];
+
+    /// @brief The squares attacked by at least two pieces per color
+    Bitboard twice[2];
+
+    /// @brief The squares around the king (including the king square) per color
+    Bitboard kingZone[2];
+
+    /// @brief The amount of pieces of each color attacking the enemy king zone
+    u8 kingAttackersCount[2];
+
+    /// @brief The summed attack weights of the pieces of each color attacking the enemy king zone
+    i32 kingAttackersWeight[2];
+
+    /// @brief The amount of attacked squares in the enemy king zone per color, counted once per attacker
+    u8 kingZoneAttacks[2];
+
+    /// @brief The safe mobility per piece type per color, which is the amount of attacked squares
+    /// not occupied by friendly pieces and not attacked by enemy pawns summed over all pieces of the type
+    u16 mobility[2][PIECE_TYPE_COUNT];
+};
+
+/// @brief The weight of an attack on the enemy king zone per piece type
+constexpr i32 kingAttackWeightPerType[] = { 0, 2, 2, 3, 5, 0, 0 };
+
 /// @brief Non-trivial or unrecoverable state of the board which may be restored from memory.
 struct VolatileBoardState {
     /// @brief The amount of moves made without a capture or pawn move
@@ -120,9 +196,38 @@ public:
     /// @brief The non trivial board state
     VolatileBoardState volatileState;
 
+    /* Material */
+
+    /// @brief The amount of pieces on the board per piece, indexed by the piece value
+    u8 pieceCounts[1 << 5] = { 0 };
+
+    /// @brief The game phase, the sum of the phase weights of all pieces on the board
+    u8 phase = 0;
+
+    /* Evaluation */
+
+    /// @brief The packed ABSOLUTE middlegame/endgame piece-square score summed over all pieces
+    Score psqScore = 0;
+
+    /// @brief The NNUE accumulators kept up to date on make/unmake, only if attached
+    nnue::AccumulatorStack* accumulatorStack = nullptr;
+
+    /// @brief The keys of the previous positions pushed on make and popped on unmake, only if attached
+    KeyHistory* keyHistory = nullptr;
+
+    /// @brief The attack map cached for the last piece placement it was requested for
+    AttackMap attackMap;
+
     /* Hashing */
 
-    PositionHash pieceZHash;
+    PositionHash pieceZHash = 0;
+
+    /// @brief Hash of the material configuration (the piece counts) on the board,
+    /// incrementally updated whenever a piece is set or unset.
+    PositionHash materialKey = 0;
+
+    /// @brief Hash of the placement of the pawns only, incrementally updated like the piece hash.
+    PositionHash pawnKey = 0;
 
 public:
     forceinline VolatileBoardState* volatile_state() const { return (VolatileBoardState*) &volatileState; }
@@ -140,6 +245,22 @@ public:
     forceinline Bitboard pieces(Color color, PieceType pt, PieceTypes... pts) const;
     forceinline Bitboard pieces_except_king(Color color) const { return pieces(color, PAWN, KNIGHT, BISHOP, ROOK, QUEEN); }
 
+    /* Material */
+    forceinline u8 count(Piece p) const { return pieceCounts[p]; }
+    forceinline u8 count(Color color, PieceType pt) const { return pieceCounts[pt | PIECE_COLOR_FOR(color)]; }
+    forceinline PositionHash material_key() const { return materialKey; }
+    forceinline PositionHash pawn_key() const { return pawnKey; }
+    forceinline void add_material(Piece p) { materialKey ^= materialHashes[MATERIAL_HASH_KEY(p, pieceCounts[p]++)]; phase += phaseWeightPerType[TYPE_OF_PIECE(p)]; }
+    forceinline void remove_material(Piece p) { materialKey ^= materialHashes[MATERIAL_HASH_KEY(p, --pieceCounts[p])]; phase -= phaseWeightPerType[TYPE_OF_PIECE(p)]; }
+    forceinline u8 game_phase() const { return phase; }
+
+    /* Evaluation */
+    forceinline Score psq_score() const { return psqScore; }
+    forceinline nnue::AccumulatorStack* accumulator_stack() const { return accumulatorStack; }
+    forceinline void set_accumulator_stack(nnue::AccumulatorStack* stack) { accumulatorStack = stack; }
+    forceinline KeyHistory* key_history() const { return keyHistory; }
+    forceinline void set_key_history(KeyHistory* history) { keyHistory = history; }
+
     /* Attacks */
     inline Bitboard calculate_attacks_on(Color color, Sq sq, /* out */ Bitboard *pinned = nullptr, /* out */ Bitboard *pinners = nullptr) const;
     inline Bitboard calculate_attacks_by(PieceType pt, Sq sq) const;
@@ -152,6 +273,16 @@ public:
 
     forceinline Bitboard pawn_attacks_by(Color color) const;
 
+    /// @brief Get the attack map for the current piece placement, only computed
+    /// if the placement changed since the last call.
+    forceinline const AttackMap* attack_map();
+
+    /// @brief Compute the full attack map for the current piece placement.
+    inline void compute_attack_map(AttackMap* map) const;
+
+    template<PieceType pt>
+    forceinline void accumulate_attack_map(AttackMap* map, Color color, Bitboard mobilityArea) const;
+
     inline Bitboard attacks_on(Sq sq, Bitboard blockers, Color attackingColor, PieceType pt) const;
     template<typename... PieceTypes>
     forceinline Bitboard attacks_on(Sq sq, Bitboard blockers, Color attackingColor, PieceType pt, PieceTypes... pts) const;
@@ -203,6 +334,11 @@ public:
     template<Color color, bool right>
     forceinline u8 find_file_of_first_rook_on_rank(u8 rank) const;
 
+    /// @brief Remove the castling right of the given color on the side of the given
+    /// rook square, if it holds the outermost rook on the back rank.
+    template<Color color>
+    forceinline void revoke_castling_for_rook(Sq sq);
+
     /// @brief Get the checking attack bitboard for the given mobility type.
     template<Color color, MobilityType mt>
     forceinline Bitboard checking_attack_bb() const;
@@ -225,17 +361,39 @@ public:
     template<Color color>
     forceinline void recalculate_state_sided();
 
-    /// @brief Load the current board status from the given FEN string
+    /// @brief Parse the FEN or 'startpos' at the start of the given text into this board, replacing the
+    /// current position. Only the placement and the side to move are required, like in EPD lines.
+    /// Castling rights without the king and rook on their squares are dropped.
+    /// @return The end of the parsed fields, where the EPD operations follow, or nullptr if the text is
+    /// no valid position, in which case the board is left unchanged.
+    const char* parse_fen(const char* p, const char* end);
+
+    /// @brief Load the given FEN or 'startpos', returns whether it was valid. Only whitespace may follow.
+    bool load_fen(std::string_view fen);
+
+    /// @brief Load the current board status from the given FEN string, an invalid one is ignored.
     /// @param str The FEN string or 'startpos'.
     void load_fen(const char* str);
 
-    /// @brief Load the current board status from the given FEN string
+    /// @brief Load the current board status from the FEN read from the given iterator, which is left
+    /// in front of whatever follows the FEN.
     /// @param it The character iterator.
     void load_fen(std::istream_iterator<char>& it, const std::istream_iterator<char>& end);
 
     /// @brief Whether the current position has insufficient material to deliver checkmate
     inline bool is_insufficient_material();
 
+    /// @brief Whether the current position is a draw by repetition according to the attached key history.
+    /// A position repeated once after the root of the search is a draw already, as the side which
+    /// could avoid the repetition could also repeat again. Before the root a threefold repetition is required.
+    /// @param searchPly The distance of the current position to the root of the search.
+    inline bool is_repetition(i32 searchPly);
+
+    /// @brief Whether the side to move has a reversible move to a position the search passed
+    /// through since the root, or which occurred twice in the game, so it can force a draw.
+    /// @param searchPly The distance of the current position to the root of the search.
+    inline bool has_upcoming_repetition(i32 searchPly);
+
     /// @brief Perform some basic checks on the given move to ensure it isn't completely absurd 
     template<bool turn>
     inline bool check_pseudo_legal(Move move) const;
@@ -266,6 +424,10 @@ forceinline void Board::set_piece(Sq index, Piece p, Color color) {
     allPiecesPerColor[color] |= 1ULL << index;    
     allPieces |= 1ULL << index;
     pieceZHash ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];
+    if (TYPE_OF_PIECE(p) == PAWN) pawnKey ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];
+    psqScore += pst::piece_square_score(p, index);
+    add_material(p);
+    if (accumulatorStack) accumulatorStack->dirty.add(p, index);
 
     // check for king update
     if (TYPE_OF_PIECE(p) == KING) {
@@ -289,6 +451,10 @@ forceinline void Board::unset_piece(Sq index, Piece p, Color color) {
     allPiecesPerColor[color] &= ~(1ULL << index);   
     allPieces &= ~(1ULL << index); 
     pieceZHash ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];
+    if (TYPE_OF_PIECE(p) == PAWN) pawnKey ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];
+    psqScore -= pst::piece_square_score(p, index);
+    remove_material(p);
+    if (accumulatorStack) accumulatorStack->dirty.remove(p, index);
 
     if constexpr (updateState) {
         recalculate_state();
@@ -306,6 +472,10 @@ forceinline void remove_piece_replaced(Board* b, Sq index, Piece p, Color color)
     b->pieceBBs[p] &= ~(1ULL << index);
     b->allPiecesPerColor[color] &= ~(1ULL << index); 
     b->pieceZHash ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];  
+    if (TYPE_OF_PIECE(p) == PAWN) b->pawnKey ^= pieceSqHashes[PIECE_HASH_KEY(p, index)];
+    b->psqScore -= pst::piece_square_score(p, index);
+    b->remove_material(p);
+    if (b->accumulatorStack) b->accumulatorStack->dirty.remove(p, index);
 }
 
 template<Color color, bool useExtMove, bool updateAttackState>
@@ -326,6 +496,15 @@ forceinline void Board::make_move_unchecked(ExtMove<useExtMove>* extMove) {
         extMove->lastState = *state;
     }
 
+    if (keyHistory) {
+        keyHistory->push(zhash());
+    }
+
+    // start recording the pieces changed by this move
+    if (accumulatorStack) {
+        accumulatorStack->dirty.reset();
+    }
+
     // 50 move rule and other board state
     state->rule50Ply++;
     if (TYPE_OF_PIECE(piece) == PAWN || captured != NULL_PIECE) {
@@ -334,12 +513,21 @@ forceinline void Board::make_move_unchecked(ExtMove<useExtMove>* extMove) {
 
     state->enPassantTarget = NULL_SQ;
 
+    // moving or capturing the castling rook of a side removes the castling right on its side
+    if (TYPE_OF_PIECE(piece) == ROOK) {
+        revoke_castling_for_rook<color>(move.src);
+    }
+
+    if (TYPE_OF_PIECE(captured) == ROOK) {
+        revoke_castling_for_rook<!color>(captureSq);
+    }
+
     // remove from source position
     unset_piece<false>(move.src, piece, color);
 
     // handle captures, en passant is handled by the capture sq
     if (captured != NULL_PIECE) {
-        if (move.dst != captureSq) {
+        if (move.dst == captureSq) {
             remove_piece_replaced(this, captureSq, captured, !color);
         } else {
             unset_piece<false>(captureSq, captured, !color);
@@ -394,6 +582,11 @@ finalize:
     // set piece at destination
     set_piece<false>(move.dst, piece, color);
 
+    // push the incrementally updated accumulator
+    if (accumulatorStack) {
+        accumulatorStack->push_update();
+    }
+
     if constexpr (updateAttackState) {
         // update state
         recalculate_state();
@@ -463,6 +656,15 @@ finalize:
         this->volatileState = extMove->lastState;
     }
 
+    // restore the accumulator of the previous ply
+    if (accumulatorStack) {
+        accumulatorStack->pop();
+    }
+
+    if (keyHistory) {
+        keyHistory->pop();
+    }
+
     // decr ply played
     ply--;
     turn = !turn;
@@ -480,6 +682,18 @@ forceinline u8 Board::find_file_of_first_rook_on_rank(u8 rank) const {
     }
 }
 
+template<Color color>
+forceinline void Board::revoke_castling_for_rook(Sq sq) {
+    constexpr u8 backRank = color ? 0 : 7;
+    if (RANK(sq) != backRank) {
+        return;
+    }
+
+    u8* castlingStatus = &volatile_state()->castlingStatus[color];
+    if (FILE(sq) == find_file_of_first_rook_on_rank<color, false>(backRank)) *castlingStatus &= ~CAN_CASTLE_L;
+    if (FILE(sq) == find_file_of_first_rook_on_rank<color, true>(backRank)) *castlingStatus &= ~CAN_CASTLE_R;
+}
+
 template<Color color, MobilityType mt>
 forceinline Bitboard Board::checking_attack_bb() const {
     if constexpr (mt == QUEEN_MOBILITY) {
@@ -562,6 +776,76 @@ forceinline Bitboard Board::pawn_attacks_by(Color color) const {
     return attacksEast | attacksWest;
 }
 
+forceinline const AttackMap* Board::attack_map() {
+    if (!attackMap.valid || attackMap.key != pieceZHash) {
+        compute_attack_map(&attackMap);
+    }
+
+    return &attackMap;
+}
+
+template<PieceType pt>
+forceinline void Board::accumulate_attack_map(AttackMap* map, Color color, Bitboard mobilityArea) const {
+    const Bitboard enemyKingZone = map->kingZone[!color];
+    Bitboard bb = pieces(color, pt);
+    while (bb) {
+        const Bitboard attacks = trivial_attack_bb<pt>(_pop_lsb(bb));
+        map->twice[color] |= map->all[color] & attacks;
+        map->all[color] |= attacks;
+        map->byType[color][pt] |= attacks;
+        map->mobility[color][pt] += _popcount64(attacks & mobilityArea);
+
+        if (attacks & enemyKingZone) {
+            map->kingAttackersCount[color]++;
+            map->kingAttackersWeight[color] += kingAttackWeightPerType[pt];
+            map->kingZoneAttacks[color] += _popcount64(attacks & enemyKingZone);
+        }
+    }
+}
+
+inline void Board::compute_attack_map(AttackMap* map) const {
+    // pawn attacks and king zones first, the mobility area
+    // and king zone attacks of the pieces depend on them
+    for (Color color : { WHITE, BLACK }) {
+        const DirectionOffset UpOffset = (color ? OFF_NORTH : OFF_SOUTH);
+        const Bitboard pawns = pieces(color, PAWN);
+        const Bitboard attacksEast = shift(pawns & BB_FILES_17_MASK, UpOffset + OFF_EAST);
+        const Bitboard attacksWest = shift(pawns & BB_FILES_28_MASK, UpOffset + OFF_WEST);
+
+        map->byType[color][PAWN] = map->all[color] = attacksEast | attacksWest;
+        map->twice[color] = attacksEast & attacksWest;
+        map->kingZone[color] = has_king(color) ? lookup::kingMovementBBs.values[king_index(color)] | (1ULL << king_index(color)) : 0;
+        map->kingAttackersCount[color] = 0;
+        map->kingAttackersWeight[color] = 0;
+        map->kingZoneAttacks[color] = 0;
+        for (u8 pt = KNIGHT; pt < PIECE_TYPE_COUNT; pt++) {
+            map->byType[color][pt] = 0;
+        }
+
+        for (u8 pt = 0; pt < PIECE_TYPE_COUNT; pt++) {
+            map->mobility[color][pt] = 0;
+        }
+    }
+
+    for (Color color : { WHITE, BLACK }) {
+        const Bitboard mobilityArea = ~pieces_for_side(color) & ~map->byType[!color][PAWN];
+        accumulate_attack_map<KNIGHT>(map, color, mobilityArea);
+        accumulate_attack_map<BISHOP>(map, color, mobilityArea);
+        accumulate_attack_map<ROOK>(map, color, mobilityArea);
+        accumulate_attack_map<QUEEN>(map, color, mobilityArea);
+
+        if (has_king(color)) {
+            const Bitboard attacks = trivial_attack_bb<KING>(king_index(color));
+            map->twice[color] |= map->all[color] & attacks;
+            map->all[color] |= attacks;
+            map->byType[color][KING] = attacks;
+        }
+    }
+
+    map->key = pieceZHash;
+    map->valid = true;
+}
+
 forceinline Bitboard Board::attacks_on(Sq sq, Bitboard blockers, Color attackingColor, PieceType pt) const {
     if (pt == PAWN) return lookup::pawnAttackBBs.values[attackingColor][sq] & pieces(attackingColor, PAWN); 
     if (pt == KNIGHT) return lookup::knightAttackBBs.values[sq] & pieces(attackingColor, KNIGHT);
@@ -602,7 +886,7 @@ forceinline void Board::recalculate_state_sided() {
     if (has_king(color)) {
         // calculate king checking squares
         const u8 kingIndex = king_index(color);
-        const Bitboard pawnCBB = this->checkingSquares[color][PAWN] = lookup::pawnAttackBBs.values[!color][kingIndex];
+        const Bitboard pawnCBB = this->checkingSquares[color][PAWN] = lookup::pawnAttackBBs.values[color][kingIndex];
         const Bitboard knightCBB = this->checkingSquares[color][KNIGHT] = lookup::knightAttackBBs.values[kingIndex];
         const u64 rookKey = lookup::magic::rook_attack_key(kingIndex, allPieces);
         const u64 bishopKey = lookup::magic::bishop_attack_key(kingIndex, allPieces);
@@ -612,14 +896,98 @@ forceinline void Board::recalculate_state_sided() {
         
         // calculate checkers
         Bitboard checkers = (pieces(!color, PAWN) & pawnCBB) | (pieces(!color, KNIGHT) & knightCBB) |
-                            (pieces(!color, ROOK, QUEEN) & rookCBB | (pieces(!color, BISHOP, QUEEN) & bishopCBB));
+                            (pieces(!color, ROOK, QUEEN) & rookCBB | (pieces(!color, BISHOP, QUEEN) & bishopCBB)) |
+                            (pieces(!color, KING) & lookup::kingMovementBBs.values[kingIndex]);
         this->kingCheckers[color] = checkers;
     }
 }
 
 forceinline bool Board::is_insufficient_material() {
-    // king and king no pieces
-    return _popcount64(allPieces) <= 2;
+    // any pawn, rook or queen can still deliver mate
+    if (pieces(PAWN, ROOK, QUEEN)) {
+        return false;
+    }
+
+    // king and king with at most one minor piece
+    const u8 minors = count(WHITE, KNIGHT) + count(WHITE, BISHOP) + count(BLACK, KNIGHT) + count(BLACK, BISHOP);
+    if (minors <= 1) {
+        return true;
+    }
+
+    // only bishops which are all on the same square color
+    const Bitboard bishops = pieces(BISHOP);
+    return count(WHITE, KNIGHT) + count(BLACK, KNIGHT) == 0 && 
+           ((bishops & BB_DARK_SQUARES) == 0 || (bishops & ~BB_DARK_SQUARES) == 0);
+}
+
+forceinline bool Board::is_repetition(i32 searchPly) {
+    if (!keyHistory) {
+        return false;
+    }
+
+    // a repetition needs at least 2 reversible moves by each side, and the side to move has
+    // to be the same so only every second position is checked
+    const i32 end = MIN((i32)volatile_state()->rule50Ply, (i32)MIN(keyHistory->count, (u32)KEY_HISTORY_SIZE));
+    const PositionHash key = zhash();
+    bool repeatedBeforeRoot = false;
+    for (i32 i = 4; i <= end; i += 2) {
+        if (keyHistory->before(i) != key) {
+            continue;
+        }
+
+        if (i < searchPly || repeatedBeforeRoot) {
+            return true;
+        }
+
+        repeatedBeforeRoot = true;
+    }
+
+    return false;
+}
+
+forceinline bool Board::has_upcoming_repetition(i32 searchPly) {
+    if (!keyHistory) {
+        return false;
+    }
+
+    // the earlier positions with the other side to move are the ones our move could lead to
+    const i32 end = MIN((i32)volatile_state()->rule50Ply, (i32)MIN(keyHistory->count, (u32)KEY_HISTORY_SIZE));
+    const PositionHash key = zhash();
+    for (i32 i = 3; i <= end; i += 2) {
+        const PositionHash moveKey = key ^ keyHistory->before(i);
+
+        u32 j = CUCKOO_H1(moveKey);
+        if (cuckooTable.keys[j] != moveKey) {
+            j = CUCKOO_H2(moveKey);
+            if (cuckooTable.keys[j] != moveKey) {
+                continue;
+            }
+        }
+
+        // the move has to be possible, so the squares between have to be empty
+        const Move move = cuckooTable.moves[j];
+        if ((between_bb_exclusive(move.src, move.dst) & allPieces) == 0) {
+            if (i < searchPly) {
+                return true;
+            }
+
+            // before the root the position reached has to have occurred twice already, the table stores
+            // both directions of a move in one entry so the piece is on either square
+            const Piece piece = piece_on(pieceArray[move.src] != NULL_PIECE ? move.src : move.dst);
+            if (IS_WHITE_PIECE(piece) != turn) {
+                continue;
+            }
+
+            const PositionHash reached = keyHistory->before(i);
+            for (i32 k = i + 4; k <= end; k += 2) {
+                if (keyHistory->before(k) == reached) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
 }
 
 template<bool turn>
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <tuple>
+
+#include "board.hh"
+#include "evaldef.hh"
+#include "pst.hh"
+
+/*
+    Compile time composition of static evaluators from a list of terms. Each term adds to the
+    shared EvalContext, the terms are split into cheap and expensive ones so the expensive terms
+    can be skipped when the cheap ones already put the score far enough outside the search window.
+ */
+
+namespace tc {
+
+/// @brief The state shared between the terms of a composed evaluation.
+struct EvalContext {
+    Board* board;
+
+    /// @brief The packed ABSOLUTE middlegame/endgame score, tapered once at the end
+    Score score = 0;
+
+    /// @brief The ABSOLUTE score which is not tapered
+    i32 value = 0;
+
+    /// @brief Set by a term which determined the final result on its own, such as a known endgame
+    bool done = false;
+    i32 result = 0;
+
+    forceinline void finish(i32 eval) { done = true; result = eval; }
+    forceinline i32 total() const { return pst::taper(score, board->game_phase()) + value; }
+};
+
+/// @brief CRTP base of evaluation terms, the derived term implements evaluate(EvalContext*).
+/// An expensive term also declares `static constexpr i32 maxMagnitude`, the most it can change the tapered score by.
+/// @tparam _Expensive Whether the term may be skipped by the lazy evaluation cutoff.
+template<typename _Derived, bool _Expensive = false>
+struct EvalTerm {
+    constexpr static bool expensive = _Expensive;
+
+    forceinline void apply(EvalContext* ctx) { static_cast<_Derived*>(this)->evaluate(ctx); }
+};
+
+/// @brief The most the given term can change the score by when it is skipped by the lazy cutoff,
+/// plus one for the rounding of the taper. Cheap terms are never skipped.
+template<typename _Term>
+constexpr i32 lazy_term_bound() {
+    if constexpr (_Term::expensive) {
+        return _Term::maxMagnitude + 1;
+    }
+
+    return 0;
+}
+
+/// @brief Static evaluator composed of the given terms, all applied inline in the order given.
+template<typename... _Terms>
+struct ComposedEvaluator {
+    std::tuple<_Terms...> terms;
+
+    /// @brief How far outside the window the score of the cheap terms has to be to skip the expensive terms, the sum
+    /// of their bounds so the cutoff is only taken when they could not bring the score back into the window.
+    static constexpr i32 lazyMargin = (0 + ... + lazy_term_bound<_Terms>());
+
+    inline i32 eval(Board* board) {
+        return eval(board, EVAL_NEGATIVE_INFINITY, EVAL_POSITIVE_INFINITY);
+    }
+
+    /// @brief Evaluate the position with lazy evaluation against the given ABSOLUTE window.
+    /// @param lazy Set to whether the expensive terms were skipped, in which case the result is only a bound.
+    inline i32 eval(Board* board, i32 lo, i32 hi, bool* lazy = nullptr) {
+        EvalContext ctx { .board = board };
+        if (lazy) *lazy = false;
+
+        if (!apply_terms<false>(&ctx)) {
+            return ctx.result;
+        }
+
+        // lazy cutoff, the expensive terms can not bring the score back into the window
+        const i32 cheapEval = ctx.total();
+        if ((i64)cheapEval + lazyMargin < lo || (i64)cheapEval - lazyMargin > hi) {
+            if (lazy) *lazy = true;
+            return cheapEval;
+        }
+
+        if (!apply_terms<true>(&ctx)) {
+            return ctx.result;
+        }
+
+        return ctx.total();
+    }
+
+private:
+    // apply all terms of the given cost class, returns false if a term finished the evaluation
+    template<bool expensive>
+    forceinline bool apply_terms(EvalContext* ctx) {
+        return std::apply([ctx](auto&... term) { return (apply_term<expensive>(term, ctx) && ...); }, terms);
+    }
+
+    template<bool expensive, typename _Term>
+    static forceinline bool apply_term(_Term& term, EvalContext* ctx) {
+        if constexpr (_Term::expensive == expensive) {
+            term.apply(ctx);
+        }
+
+        return !ctx->done;
+    }
+};
+
+}
\ No newline at end of file
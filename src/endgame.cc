@@ -0,0 +1,63 @@
+#include "endgame.hh"
+#include "bitbase.hh"
+
+namespace tc::endgame {
+
+constexpr i32 pushToEdgeWeight = iEval(0.1);
+constexpr i32 pushCloseWeight = iEval(0.1);
+constexpr i32 pushToCornerWeight = iEval(0.2);
+
+// the summed value of all non-king pieces of the given side
+static i32 material_value(Board* board, Color color) {
+    return board->count(color, PAWN) * evalValuePawn + board->count(color, KNIGHT) * evalValueKnight +
+           board->count(color, BISHOP) * evalValueBishop + board->count(color, ROOK) * evalValueRook +
+           board->count(color, QUEEN) * evalValueQueen;
+}
+
+i32 eval_known_draw([[maybe_unused]] Board* board, [[maybe_unused]] Color strongSide) {
+    return EVAL_DRAW;
+}
+
+i32 eval_kxk(Board* board, Color strongSide) {
+    const Sq strongKing = board->king_index(strongSide);
+    const Sq weakKing = board->king_index(!strongSide);
+
+    i32 score = EVAL_KNOWN_WIN + material_value(board, strongSide);
+    score += pushToEdgeWeight * (6 - edge_distance(weakKing));
+    score += pushCloseWeight * (7 - lookup::squareDistance.values[strongKing][weakKing]);
+    return SIGN_OF_COLOR(strongSide) * score;
+}
+
+i32 eval_kbnk(Board* board, Color strongSide) {
+    const Sq strongKing = board->king_index(strongSide);
+    const Sq weakKing = board->king_index(!strongSide);
+
+    // mate can only be forced in the corners of the color of the bishop
+    const bool darkBishop = (board->pieces(strongSide, BISHOP) & BB_DARK_SQUARES) > 0;
+    const Sq cornerA = darkBishop ? INDEX(fA, 0) : INDEX(fA, 7);
+    const Sq cornerB = darkBishop ? INDEX(fH, 7) : INDEX(fH, 0);
+    const u8 cornerDistance = MIN(lookup::squareDistance.values[weakKing][cornerA], lookup::squareDistance.values[weakKing][cornerB]);
+
+    i32 score = EVAL_KNOWN_WIN + evalValueBishop + evalValueKnight;
+    score += pushToCornerWeight * (7 - cornerDistance);
+    score += pushCloseWeight * (7 - lookup::squareDistance.values[strongKing][weakKing]);
+    return SIGN_OF_COLOR(strongSide) * score;
+}
+
+i32 eval_kpk(Board* board, Color strongSide) {
+    // normalize the squares so the strong side is white
+    const Sq flip = strongSide ? 0 : 56;
+    const Sq strongKing = board->king_index(strongSide) ^ flip;
+    const Sq weakKing = board->king_index(!strongSide) ^ flip;
+    const Sq pawn = _ctz64(board->pieces(strongSide, PAWN)) ^ flip;
+    const Color stm = board->turn == strongSide ? WHITE : BLACK;
+
+    // the bitbase result is exact, prefer advancing the pawn in won positions
+    if (!bitbase::probe_kpk(strongKing, pawn, weakKing, stm)) {
+        return EVAL_DRAW;
+    }
+
+    return SIGN_OF_COLOR(strongSide) * (EVAL_KNOWN_WIN + evalValuePawn + RANK(pawn) * pushToEdgeWeight);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "board.hh"
+#include "evaldef.hh"
+
+/*
+    Specialised evaluation functions for trivially decided endgames, dispatched
+    to through the material table. All return an ABSOLUTE evaluation.
+ */
+
+namespace tc::endgame {
+
+/// @brief Specialised evaluation function for a material configuration.
+/// @param strongSide The side with the material advantage the function was selected for.
+typedef i32 (*EndgameEvalFunc)(Board* board, Color strongSide);
+
+/// @brief Positions which can not be won by either side, such as KNK or KNNK.
+i32 eval_known_draw(Board* board, Color strongSide);
+
+/// @brief Mop-up of a bare king with enough material to force mate (KQK, KRK, KBBK, ...),
+/// pushes the weak king to the edge and brings the strong king closer.
+i32 eval_kxk(Board* board, Color strongSide);
+
+/// @brief King, bishop and knight against a bare king, pushes the weak king
+/// towards a corner of the color of the bishop.
+i32 eval_kbnk(Board* board, Color strongSide);
+
+/// @brief King and pawn against a bare king, exact through the KPK bitbase.
+i32 eval_kpk(Board* board, Color strongSide);
+
+/// @brief Get the distance of the given square to the closest edge (0 - 3) on either axis summed.
+forceinline u8 edge_distance(Sq sq) {
+    const u8* d = lookup::distanceFromEdge.values[sq];
+    return MIN(d[EAST], d[WEST]) + MIN(d[NORTH], d[SOUTH]);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdlib.h>
+#include <cstring>
+
+#include "board.hh"
+#include "evaldef.hh"
+
+namespace tc {
+
+/// @brief An entry in the static evaluation cache
+struct EvalCacheEntry {
+    PositionHash hash; // The full hash of the position, used to verify hits
+    i32 eval;          // The ABSOLUTE static evaluation of the position
+};
+
+/// @brief Small, lossy, direct-mapped cache of static evaluations keyed by position hash.
+/// Entries are simply overwritten on collision, a hit is only returned when the full hash matches.
+template<u8 _SizePow2>
+struct EvalCache {
+    constexpr static u64 capacity = 1ULL << _SizePow2;
+    constexpr static u64 indexMask = capacity - 1;
+
+    EvalCacheEntry* data = nullptr;
+
+    EvalCache() { data = (EvalCacheEntry*)calloc(capacity, sizeof(EvalCacheEntry)); }
+    ~EvalCache() { free(data); }
+
+    EvalCache(EvalCache const&) = delete;
+    EvalCache& operator=(EvalCache const&) = delete;
+
+    forceinline EvalCacheEntry* get(PositionHash hash) { return &data[hash & indexMask]; }
+
+    forceinline void clear() { memset(data, 0, capacity * sizeof(EvalCacheEntry)); }
+};
+
+/// @brief Evaluator which places an EvalCache in front of the given evaluator. Each search thread
+/// owns its own evaluator instance, so the cache is per thread and requires no synchronization.
+/// Only worth it for expensive evaluators.
+template<typename _Evaluator, u8 _CacheSizePow2 = 16>
+struct CachedEvaluator {
+    _Evaluator evaluator;
+    EvalCache<_CacheSizePow2> cache;
+
+    /// @brief The arguments are passed on to the evaluator.
+    template<typename... _Args>
+    CachedEvaluator(_Args&&... args) : evaluator(std::forward<_Args>(args)...) { }
+
+    inline i32 eval(Board* board) {
+        const PositionHash hash = board->zhash();
+        EvalCacheEntry* entry = cache.get(hash);
+        if (entry->hash == hash) {
+            return entry->eval;
+        }
+
+        const i32 eval = evaluator.eval(board);
+        entry->hash = hash;
+        entry->eval = eval;
+        return eval;
+    }
+
+    /// @brief Lazily evaluate against the given ABSOLUTE window if the evaluator supports it,
+    /// results which are only a bound because of the lazy cutoff are not cached.
+    inline i32 eval(Board* board, i32 lo, i32 hi) requires requires (bool* lazy) { evaluator.eval(board, lo, hi, lazy); } {
+        const PositionHash hash = board->zhash();
+        EvalCacheEntry* entry = cache.get(hash);
+        if (entry->hash == hash) {
+            return entry->eval;
+        }
+
+        bool lazy;
+        const i32 eval = evaluator.eval(board, lo, hi, &lazy);
+        if (!lazy) {
+            entry->hash = hash;
+            entry->eval = eval;
+        }
+
+        return eval;
+    }
+};
+
+}
\ No newline at end of file
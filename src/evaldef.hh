@@ -15,6 +15,8 @@
 #define ERR_EVAL  (0x1F1F1F1F)   // error evaluation
 #define NULL_EVAL (0x2F2F2F2F)   // null evaluation
 #define EVAL_DRAW 0              // any draw
+#define EVAL_KNOWN_WIN (1000 * EVAL_SCALE) // won position without a known mate, such as a trivial endgame
+#define EVAL_TB_WIN (2000 * EVAL_SCALE)    // tablebase win, decreased by the ply it was found at
 #define M0  (-9999 * EVAL_SCALE) // mate in 0
 #define MRS (9000 * EVAL_SCALE)  // where the mate range starts in positive eval
 
@@ -23,6 +25,26 @@
 #define MATED_IN_PLY(moves)     (M0 + moves)
 #define IS_MATE_EVAL(eval)      ((eval) < -MRS || (eval) > MRS)
 
+/// Whether the evaluation counts plies from the root, a mate or a tablebase win or loss.
+#define TB_RS (EVAL_TB_WIN - 100 * EVAL_SCALE) // where the tablebase range starts in positive eval
+#define IS_DECISIVE_EVAL(eval)  ((eval) < -TB_RS || (eval) > TB_RS)
+
+/// A packed middlegame/endgame score pair, the middlegame score is stored in the lower
+/// and the endgame score in the upper 32 bits so both can be summed with a single add.
+typedef i64 Score;
+
+constexpr inline Score make_score(i32 mg, i32 eg) {
+  return (Score)((u64)(i64)eg << 32) + (Score)mg;
+}
+
+constexpr inline i32 mg_value(Score score) {
+  return (i32)(u32)(u64)score;
+}
+
+constexpr inline i32 eg_value(Score score) {
+  return (i32)((score + 0x80000000LL) >> 32);
+}
+
 constexpr inline f32 fEval(i32 eval) {
   return eval / (EVAL_SCALE * (float)1);
 }
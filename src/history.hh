@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory.h>
+
+#include "types.hh"
+#include "platform.hh"
+#include "evaldef.hh"
+#include "board.hh"
+
+/*
+    Statistics learned during search, owned per thread by the ThreadSearchState so they need
+    no synchronization and carry over between the searches of a game.
+ */
+
+namespace tc {
+
+#define CORRECTION_HISTORY_SIZE  16384 // entries per side to move, a power of 2
+#define CORRECTION_HISTORY_GRAIN 16    // entry units per eval unit
+#define CORRECTION_HISTORY_LIMIT (iEval(1.0) * CORRECTION_HISTORY_GRAIN) // the largest correction, one pawn
+#define CORRECTION_HISTORY_WEIGHT_SCALE 256
+
+/// @brief The average difference between the search score and the static eval of positions with the
+/// same pawn structure and side to move, the static eval is biased in similar ways in those.
+struct CorrectionHistory {
+    i16 table[2][CORRECTION_HISTORY_SIZE] = { };
+
+    forceinline i16* entry(Board* board, Color turn) {
+        return &table[turn][board->pawn_key() & (CORRECTION_HISTORY_SIZE - 1)];
+    }
+
+    /// @brief Correct the given static eval RELATIVE to the side to move. Decided evals are left as they are.
+    forceinline i32 correct(Board* board, Color turn, i32 eval) {
+        if (eval >= EVAL_KNOWN_WIN || eval <= -EVAL_KNOWN_WIN) {
+            return eval;
+        }
+
+        return eval + *entry(board, turn) / CORRECTION_HISTORY_GRAIN;
+    }
+
+    /// @brief Move the entry of the position towards the difference between the search score and the
+    /// uncorrected static eval, both RELATIVE to the side to move, weighted by the depth of the search.
+    forceinline void update(Board* board, Color turn, i32 depth, i32 score, i32 staticEval) {
+        i16* e = entry(board, turn);
+        const i32 diff = std::clamp((score - staticEval) * CORRECTION_HISTORY_GRAIN, -CORRECTION_HISTORY_LIMIT, CORRECTION_HISTORY_LIMIT);
+        const i32 weight = MIN(depth + 1, 16);
+        *e = (i16)std::clamp((*e * (CORRECTION_HISTORY_WEIGHT_SCALE - weight) + diff * weight) / CORRECTION_HISTORY_WEIGHT_SCALE,
+                             -CORRECTION_HISTORY_LIMIT, CORRECTION_HISTORY_LIMIT);
+    }
+
+    void clear() { memset(table, 0, sizeof(table)); }
+};
+
+#define CONTINUATION_HISTORY_LIMIT 8192 // the largest magnitude of an entry
+#define CONTINUATION_HISTORY_MAX_BONUS 1200
+
+// the index of a piece in the history tables, the 6 black piece types followed by the white ones
+#define PIECE_HISTORY_INDEX(p) (TYPE_OF_PIECE(p) + 6 * IS_WHITE_PIECE(p))
+
+/// @brief How good each quiet move, by moved piece and destination, has been in reply to a previous move.
+typedef i16 PieceToHistory[12][64];
+
+/// @brief The quiet move history per previous moved piece and destination, a search stack frame
+/// points into it for the move it made so the nodes below can look up and update their replies.
+struct ContinuationHistory {
+    PieceToHistory table[12][64] = { };
+
+    forceinline PieceToHistory* get(Piece piece, Sq dst) {
+        return &table[PIECE_HISTORY_INDEX(piece)][dst];
+    }
+
+    /// @brief The bonus for a quiet move causing a cutoff at the given remaining depth, the tried quiets get it negated.
+    static forceinline i32 bonus(i32 depth) {
+        return MIN(depth * depth * 16, CONTINUATION_HISTORY_MAX_BONUS);
+    }
+
+    /// @brief Move the entry towards the limit of the sign of the bonus, by less the closer it already is.
+    static forceinline void update(i16* entry, i32 bonus) {
+        *entry += bonus - *entry * std::abs(bonus) / CONTINUATION_HISTORY_LIMIT;
+    }
+
+    void clear() { memset(table, 0, sizeof(table)); }
+};
+
+}
\ No newline at end of file
@@ -4,9 +4,10 @@ namespace tc::lookup {
 
 // Provide all vars
 extern constexpr PrecalcDistanceFromEdge distanceFromEdge { };
-extern const PrecalcPawnAttackBBs pawnAttackBBs { };
+extern constexpr PrecalcSquareDistance squareDistance { };
+extern constexpr PrecalcPawnAttackBBs pawnAttackBBs { };
 extern const PrecalcKnightAttackBBs knightAttackBBs { };
-extern const PrecalcKingMovementBBs kingMovementBBs { };
+extern constexpr PrecalcKingMovementBBs kingMovementBBs { };
 extern const PrecalcUnobstructedRookSlidingAttackBBs unobstructedRookAttackBBs { };
 extern const PrecalcUnobstructedBishopSlidingAttackBBs unobstructedBishopAttackBBs { };
 
@@ -52,11 +52,26 @@ struct PrecalcDistanceFromEdge {
     }
 };
 
+/// Pre-calculated king (Chebyshev) distance between any two squares.
+struct PrecalcSquareDistance {
+    u8 values[64][64];
+
+    constexpr PrecalcSquareDistance() : values() {
+        for (int a = 0; a < 64; a++) {
+            for (int b = 0; b < 64; b++) {
+                int dx = FILE(a) - FILE(b);
+                int dy = RANK(a) - RANK(b);
+                values[a][b] = MAX(dx < 0 ? -dx : dx, dy < 0 ? -dy : dy);
+            }
+        }
+    }
+};
+
 /// Pre-calculated bitboards for pawn attacks per color per square excluding en passant
 struct PrecalcPawnAttackBBs {
     Bitboard values[2][64];
 
-    PrecalcPawnAttackBBs() : values() {
+    constexpr PrecalcPawnAttackBBs() : values() {
         for (int color = 1; color >= 0; color--) {
             i32 direction = (color ? 8 : -8);
             for (u8 file = 0; file < 8; file++) {
@@ -111,7 +126,7 @@ struct PrecalcKnightAttackBBs {
 struct PrecalcKingMovementBBs {
     Bitboard values[64];
 
-    PrecalcKingMovementBBs() : values() {
+    constexpr PrecalcKingMovementBBs() : values() {
         for (u8 file = 0; file < 8; file++) {
             for (u8 rank = 0; rank < 8; rank++) {
                 Sq index = file + rank * 8;
@@ -235,6 +250,7 @@ struct PrecalcUnobstructedBishopSlidingAttackBBs {
 };
 
 extern const PrecalcDistanceFromEdge distanceFromEdge;
+extern const PrecalcSquareDistance squareDistance;
 extern const PrecalcPawnAttackBBs pawnAttackBBs;
 extern const PrecalcKnightAttackBBs knightAttackBBs;
 extern const PrecalcKingMovementBBs kingMovementBBs;
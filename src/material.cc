@@ -0,0 +1,88 @@
+#include "material.hh"
+
+namespace tc {
+
+// the summed value of all non-pawn, non-king pieces of the given side
+static i32 non_pawn_material(Board* board, Color color) {
+    return board->count(color, KNIGHT) * evalValueKnight + board->count(color, BISHOP) * evalValueBishop +
+           board->count(color, ROOK) * evalValueRook + board->count(color, QUEEN) * evalValueQueen;
+}
+
+// whether the given side has no pieces other than the king
+static bool is_bare_king(Board* board, Color color) {
+    return board->count(color, PAWN) + board->count(color, KNIGHT) + board->count(color, BISHOP) +
+           board->count(color, ROOK) + board->count(color, QUEEN) == 0;
+}
+
+// select the specialised evaluator for the given material, if any applies
+static void select_eval_func(Board* board, MaterialEntry* entry) {
+    entry->evalFunc = nullptr;
+
+    // no side can make progress, such as KNK, KBKB or KNNK
+    const bool noPawns = board->count(WHITE, PAWN) + board->count(BLACK, PAWN) == 0;
+    if (noPawns && non_pawn_material(board, WHITE) <= evalValueBishop && non_pawn_material(board, BLACK) <= evalValueBishop) {
+        entry->evalFunc = &endgame::eval_known_draw;
+        return;
+    }
+
+    if (noPawns && board->count(WHITE, ROOK) + board->count(BLACK, ROOK) + board->count(WHITE, QUEEN) + board->count(BLACK, QUEEN) == 0 &&
+        ((board->count(WHITE, KNIGHT) == 2 && is_bare_king(board, BLACK) && board->count(WHITE, BISHOP) == 0) ||
+         (board->count(BLACK, KNIGHT) == 2 && is_bare_king(board, WHITE) && board->count(BLACK, BISHOP) == 0))) {
+        entry->evalFunc = &endgame::eval_known_draw;
+        return;
+    }
+
+    for (Color strong : { WHITE, BLACK }) {
+        if (!is_bare_king(board, !strong)) {
+            continue;
+        }
+
+        entry->strongSide = strong;
+
+        // KBNK
+        if (board->count(strong, PAWN) == 0 && board->count(strong, ROOK) == 0 && board->count(strong, QUEEN) == 0 &&
+            board->count(strong, BISHOP) == 1 && board->count(strong, KNIGHT) == 1) {
+            entry->evalFunc = &endgame::eval_kbnk;
+            return;
+        }
+
+        // KPK
+        if (board->count(strong, PAWN) == 1 && non_pawn_material(board, strong) == 0) {
+            entry->evalFunc = &endgame::eval_kpk;
+            return;
+        }
+
+        // KXK, enough material to force mate
+        if (non_pawn_material(board, strong) >= evalValueRook) {
+            entry->evalFunc = &endgame::eval_kxk;
+            return;
+        }
+    }
+}
+
+void compute_material_entry(Board* board, MaterialEntry* entry) {
+    // compute game phase
+    u32 phase = 0;
+    for (PieceType pt : { KNIGHT, BISHOP, ROOK, QUEEN }) {
+        phase += phaseWeightPerType[pt] * (board->count(WHITE, pt) + board->count(BLACK, pt));
+    }
+
+    entry->phase = MIN(phase, PHASE_MAX);
+
+    // compute material and imbalance score
+    i32 score = 0;
+    for (Color color : { WHITE, BLACK }) {
+        i32 sideScore = board->count(color, PAWN) * evalValuePawn + non_pawn_material(board, color);
+        if (board->count(color, BISHOP) >= 2) {
+            sideScore += evalBishopPair;
+        }
+
+        score += SIGN_OF_COLOR(color) * sideScore;
+    }
+
+    entry->imbalance = score;
+    entry->strongSide = score >= 0 ? WHITE : BLACK;
+    select_eval_func(board, entry);
+}
+
+}
\ No newline at end of file
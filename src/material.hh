@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include "board.hh"
+#include "evaldef.hh"
+#include "endgame.hh"
+
+namespace tc {
+
+/// @brief Cached information about a material configuration, keyed by the material key of the board.
+struct MaterialEntry {
+    PositionHash key;
+    i32 imbalance;    // The ABSOLUTE material score including imbalance terms
+    u8 phase;         // The game phase from PHASE_MAX (opening) to 0 (endgame)
+    Color strongSide; // The side the specialised evaluator was selected for
+
+    /// @brief The specialised evaluator for this material configuration, or nullptr if none applies
+    endgame::EndgameEvalFunc evalFunc;
+
+    forceinline bool has_eval_func() const { return evalFunc != nullptr; }
+    forceinline i32 eval(Board* board) const { return evalFunc(board, strongSide); }
+};
+
+/// @brief Compute the material entry for the material configuration on the given board.
+void compute_material_entry(Board* board, MaterialEntry* entry);
+
+/// @brief Direct-mapped hash table of material entries, intended to be owned per thread
+/// (by the evaluator) so no synchronization is needed. Entries are computed on a miss.
+template<u8 _SizePow2>
+struct MaterialTable {
+    constexpr static u64 capacity = 1ULL << _SizePow2;
+    constexpr static u64 indexMask = capacity - 1;
+
+    MaterialEntry* data = nullptr;
+
+    MaterialTable() { data = (MaterialEntry*)calloc(capacity, sizeof(MaterialEntry)); }
+    ~MaterialTable() { free(data); }
+
+    MaterialTable(MaterialTable const&) = delete;
+    MaterialTable& operator=(MaterialTable const&) = delete;
+
+    forceinline MaterialEntry* probe(Board* board) {
+        const PositionHash key = board->material_key();
+        MaterialEntry* entry = &data[key & indexMask];
+        if (entry->key != key || key == 0) {
+            compute_material_entry(board, entry);
+            entry->key = key;
+        }
+
+        return entry;
+    }
+};
+
+}
\ No newline at end of file
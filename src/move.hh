@@ -117,6 +117,10 @@ struct Move {
         return src == from && dst == to;
     }
 
+    forceinline bool eq(Move other) const {
+        return src == other.src && dst == other.dst && flags == other.flags;
+    }
+
     static forceinline bool is_double_push(u8 flags) { return flags == MOVE_DOUBLE_PUSH; }
     static forceinline bool is_en_passant(u8 flags) { return flags == MOVE_EN_PASSANT; }
     static forceinline bool is_promotion(u8 flags) { return flags == MOVE_PROMOTE_KNIGHT || flags == MOVE_PROMOTE_BISHOP || flags == MOVE_PROMOTE_ROOK || flags == MOVE_PROMOTE_QUEEN; }
@@ -4,6 +4,7 @@
 #include "move.hh"
 #include "lookup.hh"
 #include "tt.hh"
+#include "history.hh"
 
 #include <algorithm>
 
@@ -199,13 +200,22 @@ inline void movegen_king(Board* board, _Consumer* consumer, Sq index, Piece p) {
     const Bitboard enemyBB = board->allPiecesPerColor[!color];
     const u8 file = FILE(index);
     const u8 rank = RANK(index);
-    const Bitboard attacked = board->attacks_by(!color);
+    const Bitboard attacked = board->attack_map()->all[!color];
 
     // castling move gen //
     auto addCastlingMove = [&](u8 dstIndex, u8 rookFile, bool right) __attribute__((always_inline)) {
-        if (rookFile == NULL_SQ) return;
+        if (rookFile == NULL_SQ || (right ? rookFile < file : rookFile > file)) return;
 
-        Bitboard unattackedCondition = (right ? (0b00000011ULL << index) : (0b00000011ULL << (index - 3)));
+        // all squares between the king and rook have to be empty
+        const Sq rookIndex = INDEX(rookFile, rank);
+        Bitboard emptyCondition = right ? ((1ULL << rookIndex) - 1) & ~((2ULL << index) - 1)
+                                        : ((1ULL << index) - 1) & ~((2ULL << rookIndex) - 1);
+        if ((board->allPieces & emptyCondition) > 0) {
+            return; // discard
+        }
+
+        // the king can not pass through or land on an attacked square
+        Bitboard unattackedCondition = (right ? (0b00000011ULL << (index + 1)) : (0b00000011ULL << (index - 2)));
         if ((attacked & unattackedCondition) > 0) {
             return; // discard
         }
@@ -314,6 +324,18 @@ struct MoveList {
 #endif
     }
 
+    /// @brief Score all moves with the move orderer plus the given extra score per move, then sort them.
+    template<bool turn, typename ExtraScore>
+    forceinline void sort_moves(Board* board, ExtraScore extraScore) {
+        for (int i = 0; i < count; i++) {
+            moves[i].score = (i16)(score_move<turn>(board, moves[i].move) + extraScore(moves[i].move));
+        }
+
+        std::sort((MoveScorePair*) &moves, (MoveScorePair*) &moves[count], [&](MoveScorePair a, MoveScorePair b) {
+            return a.score < b.score; // ascending order
+        });
+    }
+
     template<Color turn, PieceType pt, bool isCapture, u8 flags>
     forceinline void acceptx(Board* board, Move move) {
 #ifndef TC_MOVE_INSERT_SORT
@@ -429,6 +451,10 @@ struct MoveSupplier {
 
     Move ttMove;
 
+    /// @brief The continuation histories of the moves one and two plies up, used to order
+    /// the quiets if set.
+    PieceToHistory* continuationHistories[2] = { nullptr, nullptr };
+
     MoveSupplier(Board* board) {
         this->board = board;
     }
@@ -466,11 +492,10 @@ struct MoveSupplier {
                 index = moveList.count;
                 stage--;
             case CAPTURES:
-                index--;
-                if (!index) {
+                if (index == 0) {
                     stage--;
                 } else {
-                    return moveList.moves[index].move;
+                    return moveList.moves[--index].move;
                 }
             
             /* quiets */
@@ -482,20 +507,46 @@ struct MoveSupplier {
                     return NULL_MOVE;
                 }
 
-                moveList.sort_moves<turn>(board);
+                if (continuationHistories[0] || continuationHistories[1]) {
+                    moveList.sort_moves<turn>(board, [&](Move move) {
+                        const i32 index = PIECE_HISTORY_INDEX(board->piece_on(move.src));
+                        return (continuationHistories[0] ? (*continuationHistories[0])[index][move.dst] : 0) +
+                               (continuationHistories[1] ? (*continuationHistories[1])[index][move.dst] : 0);
+                    });
+                } else {
+                    moveList.sort_moves<turn>(board);
+                }
                 index = moveList.count;
                 stage--;
             case QUIETS:
-                index--;
-                if (!index) {
+                if (index == 0) {
                     stage--;
                 } else {
-                    return moveList.moves[index].move;
+                    return moveList.moves[--index].move;
                 }
         }
         
         return NULL_MOVE;
     }
+
+    /// @brief Get the next capture in the order of the capture stage, without the tt move or
+    /// quiet stages. Returns NULL_MOVE once all captures have been supplied.
+    template<Color turn>
+    forceinline Move next_capture() {
+        if (stage > CAPTURES) {
+            gen_all_moves<decltype(moveList), movegenCapturesPL, turn>(board, &moveList);
+            moveList.sort_moves<turn>(board);
+            index = moveList.count;
+            stage = CAPTURES;
+        }
+
+        if (stage != CAPTURES || index == 0) {
+            stage = STAGE_ENDED;
+            return NULL_MOVE;
+        }
+
+        return moveList.moves[--index].move;
+    }
 };
 
 }
\ No newline at end of file
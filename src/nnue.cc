@@ -0,0 +1,56 @@
+#include "nnue.hh"
+#include "board.hh"
+
+namespace tc::nnue {
+
+bool Network::load(const char* path) {
+    unload();
+    if (!file.map(path)) {
+        return false;
+    }
+
+    // validate the header and size
+    const NetworkHeader* header = (const NetworkHeader*) file.data;
+    if (file.size != file_size() || header->magic != NNUE_MAGIC || header->version != NNUE_VERSION ||
+        header->inputSize != NNUE_INPUT_SIZE || header->hiddenSize != NNUE_HIDDEN_SIZE) {
+        unload();
+        return false;
+    }
+
+    // point the parameters into the mapped file, every block
+    // starts on a 64 byte boundary so aligned loads are fine
+    const u8* ptr = file.data + sizeof(NetworkHeader);
+    ftWeights = (const i16*) ptr;
+    ptr += NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE * sizeof(i16);
+    ftBiases = (const i16*) ptr;
+    ptr += NNUE_HIDDEN_SIZE * sizeof(i16);
+    outWeights = (const i8*) ptr;
+    ptr += 2 * NNUE_HIDDEN_SIZE * sizeof(i8);
+    outBias = *(const i32*) ptr;
+    return true;
+}
+
+void Network::unload() {
+    file.unmap();
+    ftWeights = nullptr;
+    ftBiases = nullptr;
+    outWeights = nullptr;
+    outBias = 0;
+}
+
+void refresh_accumulator(const Network* network, Board* board, Accumulator* acc) {
+    // add all feature columns to the biases in a single pass over the accumulator
+    const i16* columns[32];
+    for (Color perspective : { WHITE, BLACK }) {
+        u8 count = 0;
+        Bitboard bb = board->all_pieces();
+        while (bb && count < 32) {
+            const Sq sq = _pop_lsb(bb);
+            columns[count++] = network->ftWeights + feature_index(perspective, board->piece_on(sq), sq) * NNUE_HIDDEN_SIZE;
+        }
+
+        update_accumulator(network->ftBiases, acc->values[perspective], columns, count, nullptr, 0);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <stdlib.h>
+#include <memory.h>
+#include <immintrin.h>
+
+#include "types.hh"
+#include "platform.hh"
+#include "piece.hh"
+#include "evaldef.hh"
+#include "util.hh"
+
+/*
+    Efficiently updatable neural network evaluation. The network is a feature transformer
+    (768 piece-square inputs -> NNUE_HIDDEN_SIZE, per perspective) followed by a clipped ReLU
+    and a single output neuron over both perspectives, side to move first.
+
+    The feature transformer is quantised to int16 and the output layer to int8. The board keeps
+    the accumulator (the feature transformer output) updated on make/unmake through the
+    AccumulatorStack, which holds one snapshot per ply so unmaking is just a pop.
+ */
+
+namespace tc { struct Board; }
+
+namespace tc::nnue {
+
+#define NNUE_INPUT_SIZE   768    // 2 colors * 6 piece types * 64 squares
+#define NNUE_HIDDEN_SIZE  256    // The accumulator size per perspective
+#define NNUE_QA           127    // Feature transformer quantization, also the clipped ReLU upper bound
+#define NNUE_QB           64     // Output layer quantization
+#define NNUE_OUTPUT_SCALE 400    // Centipawns per unit of network output
+#define NNUE_MAX_PLY      256    // The maximum amount of accumulator snapshots
+#define NNUE_MAGIC        0x4E4E4354 // "TCNN"
+#define NNUE_VERSION      1
+
+/// @brief The header of a network file, the parameters follow directly after in
+/// the order they are declared in Network, each block aligned to 64 bytes.
+struct NetworkHeader {
+    u32 magic;
+    u32 version;
+    u32 inputSize;
+    u32 hiddenSize;
+    u8 reserved[48];
+};
+
+static_assert(sizeof(NetworkHeader) == 64);
+
+/// @brief The quantised network parameters, pointing directly into the memory mapped file.
+struct Network {
+    const i16* ftWeights;  // [NNUE_INPUT_SIZE][NNUE_HIDDEN_SIZE], one weight column per feature
+    const i16* ftBiases;   // [NNUE_HIDDEN_SIZE]
+    const i8* outWeights;  // [2 * NNUE_HIDDEN_SIZE], side to move perspective first
+    i32 outBias;
+
+    MappedFile file;
+
+    /// @brief Map the network file at the given path, returns whether the file was valid.
+    bool load(const char* path);
+    void unload();
+
+    forceinline bool loaded() const { return file.mapped(); }
+
+    /// @brief The expected size of a network file in bytes.
+    static constexpr u64 file_size() {
+        return sizeof(NetworkHeader) + NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE * sizeof(i16) +
+               NNUE_HIDDEN_SIZE * sizeof(i16) + 2 * NNUE_HIDDEN_SIZE * sizeof(i8) + 64;
+    }
+};
+
+/// @brief Get the input feature index of the given piece on the given square from the given perspective.
+forceinline u32 feature_index(Color perspective, Piece p, Sq sq) {
+    const Color pieceColor = IS_WHITE_PIECE(p);
+    const Sq relativeSq = perspective ? sq : (sq ^ 56);
+    return ((pieceColor != perspective) * 6 + TYPE_OF_PIECE(p)) * 64 + relativeSq;
+}
+
+/// @brief The feature transformer output for both perspectives, indexed by color.
+struct alignas(64) Accumulator {
+    i16 values[2][NNUE_HIDDEN_SIZE];
+};
+
+/// @brief The pieces added and removed by the move currently being made.
+struct DirtyPieces {
+    u8 addedCount = 0;
+    u8 removedCount = 0;
+    Piece added[4];
+    Sq addedSq[4];
+    Piece removed[4];
+    Sq removedSq[4];
+
+    forceinline void reset() { addedCount = removedCount = 0; }
+    forceinline void add(Piece p, Sq sq) { if (addedCount < 4) { added[addedCount] = p; addedSq[addedCount++] = sq; } }
+    forceinline void remove(Piece p, Sq sq) { if (removedCount < 4) { removed[removedCount] = p; removedSq[removedCount++] = sq; } }
+};
+
+/* ------------- SIMD kernels ------------- */
+
+/// @brief dst = src + sum(add columns) - sum(sub columns) over one perspective.
+forceinline void update_accumulator(const i16* src, i16* dst, const i16** add, u8 addCount, const i16** sub, u8 subCount) {
+#ifdef __AVX2__
+    constexpr int registerWidth = 16;
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += registerWidth) {
+        __m256i v = _mm256_load_si256((const __m256i*)(src + i));
+        for (u8 j = 0; j < addCount; j++) v = _mm256_add_epi16(v, _mm256_load_si256((const __m256i*)(add[j] + i)));
+        for (u8 j = 0; j < subCount; j++) v = _mm256_sub_epi16(v, _mm256_load_si256((const __m256i*)(sub[j] + i)));
+        _mm256_store_si256((__m256i*)(dst + i), v);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+        i16 v = src[i];
+        for (u8 j = 0; j < addCount; j++) v += add[j][i];
+        for (u8 j = 0; j < subCount; j++) v -= sub[j][i];
+        dst[i] = v;
+    }
+#endif
+}
+
+/// @brief The dot product of the clipped ReLU activated accumulator half and the output weights.
+forceinline i32 output_dot(const i16* acc, const i8* weights) {
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+        __m256i v = _mm256_load_si256((const __m256i*)(acc + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        __m256i w = _mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*)(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+    }
+
+    // horizontal sum
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b01001110));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b10110001));
+    return _mm_cvtsi128_si32(s);
+#else
+    i32 sum = 0;
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+        i32 v = MIN(MAX(acc[i], 0), NNUE_QA);
+        sum += v * weights[i];
+    }
+
+    return sum;
+#endif
+}
+
+/// @brief Evaluate the network output for the given accumulator from the perspective of the side to move, in eval units.
+forceinline i32 evaluate(const Network* network, const Accumulator* acc, Color sideToMove) {
+    i32 sum = output_dot(acc->values[sideToMove], network->outWeights) +
+              output_dot(acc->values[!sideToMove], network->outWeights + NNUE_HIDDEN_SIZE) +
+              network->outBias;
+    i32 centipawns = (i64)sum * NNUE_OUTPUT_SCALE / (NNUE_QA * NNUE_QB);
+    return centipawns * EVAL_SCALE / 100;
+}
+
+/// @brief Recompute the given accumulator from scratch for the given board.
+void refresh_accumulator(const Network* network, Board* board, Accumulator* acc);
+
+/// @brief Stack of accumulator snapshots, one per ply. Attached to a board which will
+/// push an incrementally updated accumulator on every move made and pop it on unmake.
+struct AccumulatorStack {
+    const Network* network = nullptr;
+    Accumulator* data = nullptr;
+    u32 index = 0;
+
+    /// @brief The changes of the move being made, recorded by the board
+    DirtyPieces dirty;
+
+    AccumulatorStack() { data = (Accumulator*)_mm_malloc(NNUE_MAX_PLY * sizeof(Accumulator), alignof(Accumulator)); }
+    ~AccumulatorStack() { _mm_free(data); }
+
+    AccumulatorStack(AccumulatorStack const&) = delete;
+    AccumulatorStack& operator=(AccumulatorStack const&) = delete;
+
+    forceinline Accumulator* top() { return &data[index]; }
+
+    /// @brief Reset the stack to a single accumulator computed from scratch for the given board.
+    inline void refresh(Board* board) {
+        index = 0;
+        refresh_accumulator(network, board, top());
+    }
+
+    /// @brief Push a new accumulator, computed by applying the dirty pieces to the current top.
+    forceinline void push_update() {
+        const i16* add[4];
+        const i16* sub[4];
+        Accumulator* src = top();
+        Accumulator* dst = &data[++index];
+
+        for (Color perspective : { WHITE, BLACK }) {
+            for (u8 i = 0; i < dirty.addedCount; i++) add[i] = network->ftWeights + feature_index(perspective, dirty.added[i], dirty.addedSq[i]) * NNUE_HIDDEN_SIZE;
+            for (u8 i = 0; i < dirty.removedCount; i++) sub[i] = network->ftWeights + feature_index(perspective, dirty.removed[i], dirty.removedSq[i]) * NNUE_HIDDEN_SIZE;
+            update_accumulator(src->values[perspective], dst->values[perspective], add, dirty.addedCount, sub, dirty.removedCount);
+        }
+    }
+
+    /// @brief Restore the snapshot of the previous ply.
+    forceinline void pop() {
+        index--;
+    }
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "search.hh"
+#include "nnue.hh"
+
+namespace tc {
+
+/// @brief Static evaluation by the NNUE. While attached to a board the accumulators are
+/// updated incrementally by the board on make/unmake, otherwise every eval is a full refresh.
+struct NNUEEvaluator {
+    const nnue::Network* network;
+    nnue::AccumulatorStack accumulators;
+    Board* attachedBoard = nullptr;
+
+    /// @brief Where boards other than the attached one are evaluated, apart from the stack so they never overwrite a live snapshot
+    nnue::Accumulator scratch;
+
+    NNUEEvaluator(const nnue::Network* network) : network(network) {
+        accumulators.network = network;
+    }
+
+    ~NNUEEvaluator() { detach(); }
+
+    /// @brief Start incrementally updating the accumulators from the given board.
+    inline void attach(Board* board) {
+        detach();
+        accumulators.refresh(board);
+        board->set_accumulator_stack(&accumulators);
+        attachedBoard = board;
+    }
+
+    inline void detach() {
+        if (attachedBoard) {
+            attachedBoard->set_accumulator_stack(nullptr);
+            attachedBoard = nullptr;
+        }
+    }
+
+    inline i32 eval(Board* board) {
+        nnue::Accumulator* acc = accumulators.top();
+        if (board != attachedBoard) {
+            // not attached, compute from scratch
+            acc = &scratch;
+            nnue::refresh_accumulator(network, board, acc);
+        }
+
+        // the network is relative to the side to move
+        return SIGN_OF_COLOR(board->turn) * nnue::evaluate(network, acc, board->turn);
+    }
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "packedpos.hh"
+#include "board.hh"
+
+namespace tc {
+
+void pack_position(Board* board, PackedPosition* out) {
+    memset(out, 0, sizeof(PackedPosition));
+    out->occupied = board->all_pieces();
+    out->turn = board->turn;
+
+    Bitboard bb = out->occupied;
+    for (u8 i = 0; bb; i++) {
+        const Piece p = board->piece_on(_pop_lsb(bb));
+        const u8 nibble = TYPE_OF_PIECE(p) | (IS_WHITE_PIECE(p) << 3);
+        out->pieces[i >> 1] |= nibble << ((i & 1) * 4);
+    }
+}
+
+void unpack_position(const PackedPosition* in, Board* board) {
+    Bitboard bb = board->all_pieces();
+    while (bb) {
+        const Sq sq = _pop_lsb(bb);
+        board->unset_piece<false>(sq, board->piece_on(sq));
+    }
+
+    in->for_each_piece([&](Piece p, Sq sq) { board->set_piece<false>(sq, p); });
+
+    board->turn = in->turn;
+    VolatileBoardState* state = board->volatile_state();
+    state->rule50Ply = 0;
+    state->enPassantTarget = NULL_SQ;
+    state->castlingStatus[WHITE] = state->castlingStatus[BLACK] = 0;
+    board->recalculate_state();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.hh"
+#include "platform.hh"
+#include "piece.hh"
+#include "bitboard.hh"
+
+/*
+    Compact fixed size position records for datasets, such as labelled training and tuning data.
+    The occupancy bitboard is followed by one nibble per occupied square in ascending square
+    order, so any legal position fits into 32 bytes together with the side to move and the labels.
+    Castling rights, the en passant square and the move counters are not stored.
+ */
+
+namespace tc { struct Board; }
+
+namespace tc {
+
+#define PACKED_RESULT_LOSS 0 // the game results, from the perspective of white
+#define PACKED_RESULT_DRAW 1
+#define PACKED_RESULT_WIN  2
+
+struct PackedPosition {
+    Bitboard occupied;
+    u8 pieces[16];  // the piece type (low 3 bits) and whether it is white (bit 3) per occupied square, 2 per byte
+    u8 turn;        // whether white is to move
+    u8 result;      // the game result, PACKED_RESULT_*
+    i16 score;      // the ABSOLUTE search score in centipawns, if labelled
+    u8 reserved[4];
+
+    /// @brief The piece on the i-th occupied square, counted from the lowest square.
+    forceinline Piece piece(u8 i) const {
+        const u8 nibble = (pieces[i >> 1] >> ((i & 1) * 4)) & 0xF;
+        return (nibble & 7) | PIECE_COLOR_FOR(nibble >> 3);
+    }
+
+    /// @brief Call fn(piece, sq) for every piece on the board, in ascending square order.
+    template<typename F>
+    forceinline void for_each_piece(F&& fn) const {
+        Bitboard bb = occupied;
+        for (u8 i = 0; bb; i++) {
+            fn(piece(i), _pop_lsb(bb));
+        }
+    }
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+
+/// @brief Pack the pieces and side to move of the given board, the labels are left zero.
+void pack_position(Board* board, PackedPosition* out);
+
+/// @brief Load the given packed position into the board, replacing everything on it. The board has
+/// no castling rights or en passant square afterwards.
+void unpack_position(const PackedPosition* in, Board* board);
+
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "types.hh"
 #include "evaldef.hh"
+#include "evalparams.hh"
 #include <stdlib.h>
 
 namespace tc {
@@ -87,12 +88,10 @@ inline const char* pieceToUnicode(Piece p) {
     return typeAndColorToIcon[TYPE_OF_PIECE(p) * (1 + IS_WHITE_PIECE(p))];
 }
 
-// Material Values
-constexpr i32 evalValuePawn   = iEval(1.0);
-constexpr i32 evalValueKnight = iEval(3.0);
-constexpr i32 evalValueBishop = iEval(3.0);
-constexpr i32 evalValueRook   = iEval(5.0);
-constexpr i32 evalValueQueen  = iEval(9.0);
+// The phase weight of each piece type, the phase is the sum of these over all pieces on
+// the board and starts at PHASE_MAX in the opening, then decreases towards 0 in the endgame
+#define PHASE_MAX 24
+static const u8 phaseWeightPerType[] = { 0, 1, 1, 2, 4, 0, 0 };
 
 static i16 materialValuePerType[] = {
     1, // Pawn
@@ -0,0 +1,26 @@
+#include "pst.hh"
+
+namespace tc::pst {
+
+static const i16* mgTablePerType[] = { pawnMg, knightMg, bishopMg, rookMg, queenMg, kingMg };
+static const i16* egTablePerType[] = { pawnEg, knightEg, bishopEg, rookEg, queenEg, kingEg };
+
+PrecalcPieceSquareScores::PrecalcPieceSquareScores() : values() {
+    constexpr i32 centipawn = iEval(0.01);
+
+    for (u8 pt = PAWN; pt < PIECE_TYPE_COUNT; pt++) {
+        for (Sq sq = 0; sq < 64; sq++) {
+            // the tables are laid out from the 8th rank down,
+            // black uses the vertically mirrored square
+            const u8 whiteIndex = (7 - RANK(sq)) * 8 + FILE(sq);
+            const u8 blackIndex = RANK(sq) * 8 + FILE(sq);
+
+            values[pt | WHITE_PIECE][sq] = make_score(mgTablePerType[pt][whiteIndex] * centipawn, egTablePerType[pt][whiteIndex] * centipawn);
+            values[pt | BLACK_PIECE][sq] = make_score(-mgTablePerType[pt][blackIndex] * centipawn, -egTablePerType[pt][blackIndex] * centipawn);
+        }
+    }
+}
+
+extern const PrecalcPieceSquareScores pieceSquareScores { };
+
+}
\ No newline at end of file
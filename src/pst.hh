@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.hh"
+#include "platform.hh"
+#include "piece.hh"
+#include "evaldef.hh"
+
+/*
+    Tapered piece-square tables, maintained incrementally by the board
+    in set_piece/unset_piece as a packed middlegame/endgame score.
+ */
+
+namespace tc::pst {
+
+/// Pre-calculated packed PST score per piece (indexed by piece value) per square,
+/// already mirrored and negated for black so the sum over all pieces is ABSOLUTE.
+struct PrecalcPieceSquareScores {
+    Score values[1 << 5][64];
+
+    PrecalcPieceSquareScores();
+};
+
+extern const PrecalcPieceSquareScores pieceSquareScores;
+
+forceinline Score piece_square_score(Piece p, Sq sq) {
+    return pieceSquareScores.values[p][sq];
+}
+
+/// @brief Interpolate the given packed score by the game phase.
+forceinline i32 taper(Score score, i32 phase) {
+    phase = MIN(phase, PHASE_MAX);
+    return (mg_value(score) * phase + eg_value(score) * (PHASE_MAX - phase)) / PHASE_MAX;
+}
+
+}
\ No newline at end of file
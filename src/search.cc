@@ -9,4 +9,10 @@ void TranspositionTable::alloc(u32 powerOf2) {
     this->data = (TTEntry*)calloc(capacity, sizeof(TTEntry));
 }
 
+void TranspositionTable::clear() {
+    std::fill(data, data + capacity, TTEntry {});
+    used = 0;
+    generation = 0;
+}
+
 }
\ No newline at end of file
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+
 #include "board.hh"
 #include "debug.hh"
 #include "movegen.hh"
 #include "evaldef.hh"
+#include "evalcache.hh"
+#include "endgame.hh"
+#include "syzygy.hh"
+#include "tbgen.hh"
+#include "history.hh"
+#include "see.hh"
+#include "timeman.hh"
 
 namespace tc {
 
@@ -47,6 +57,8 @@ struct SearchMetrics {
     u64 captures = 0;
     u64 rule50Draws = 0;
     u64 insufficientMaterial = 0;
+    u64 repetitions = 0;
+    u64 upcomingRepetitions = 0;
 
     u64 illegal = 0;
     u64 totalPseudoLegal = 0;
@@ -57,13 +69,66 @@ struct SearchMetrics {
     u64 ttOverwrites = 0;
     u64 ttHashMoves = 0;
     u64 ttHashMovePrunes = 0;
+    u64 ttStaticEvalHits = 0;
+
+    u64 staticEvals = 0;
+    u64 reverseFutilityPrunes = 0;
+    u64 singularSearches = 0;
+    u64 singularExtensions = 0;
+    u64 multiCuts = 0;
+    u64 probCutSearches = 0;
+    u64 probCuts = 0;
+    u64 iirReductions = 0;
+    u64 qsearchSeePrunes = 0;
+
+    u64 bitbaseHits = 0;
+    u64 tbProbes = 0;
+    u64 tbHits = 0;
+    u64 dtmHits = 0;
 };
 
 #define MAX_DEPTH 64
 
+#define RFP_MAX_DEPTH 6          // the highest remaining depth reverse futility pruning is done at
+#define RFP_MARGIN    iEval(0.8) // how far the static eval has to be above beta per ply of remaining depth, one ply less when improving
+
+#define SINGULAR_MIN_DEPTH 6           // the lowest remaining depth the tt move is tested for singularity at
+#define SINGULAR_TT_DEPTH_SLACK 3      // how much shallower than the node the tt lower bound may be
+#define SINGULAR_MARGIN iEval(0.02)    // how far below the tt score all other moves have to stay per ply of depth
+
+#define PROBCUT_MIN_DEPTH 5          // the lowest remaining depth probcut is tried at
+#define PROBCUT_REDUCTION 4          // how much shallower the verification search is
+#define PROBCUT_MARGIN    iEval(2.0) // how far above beta the reduced search has to be
+#define PROBCUT_IMPROVING_DISCOUNT iEval(0.5) // how much smaller the margin is when improving
+
+#define IIR_MIN_DEPTH 4 // the lowest remaining depth a node without a tt move is reduced at
+
+#define QSEARCH_EVASION_PLIES 2 // the first qsearch plies all evasions are searched at when in check, deeper only captures
+
+#define MAX_TRACKED_QUIETS 64 // the most quiet moves per node penalized in the histories on a cutoff
+
+#define MAX_MULTI_PV 64 // the most lines searched at the root in multipv mode
+
 /// @brief The stack frame for a node
 struct SearchStackFrame {
     Move move; // The move being currently evaluated
+
+    /// @brief The move to skip in this node, set by the parent before the call to verify
+    /// that no other move comes close to it. The node is then searched at the same ply.
+    Move excludedMove = NULL_MOVE;
+
+    u16 ply; // The distance to the root of the search
+
+    /// @brief The frame of the previous position, the frame of a search excluding a move shares
+    /// the parent of the frame it was called from. Null for the root.
+    SearchStackFrame* parent;
+
+    i32 staticEval; // The corrected static eval RELATIVE to the side to move, NULL_EVAL when in check
+    bool inCheck;
+    u8 reduction;   // The plies the remaining depth of this node was reduced by
+
+    /// @brief The continuation history entry of the move being currently evaluated.
+    PieceToHistory* continuationHistory;
 };
 
 /// @brief Stack allocated search stack
@@ -96,14 +161,45 @@ struct SearchState {
     u32 maxPrimaryDepth;
     SearchStack stack;
 
+    /// @brief The moves to search at the root, all legal moves if empty. Set by the caller
+    /// for the root position and narrowed down by search_prepare_root
+    Move rootMoves[MAX_MOVES];
+    u16 rootMoveCount = 0;
+
+    /// @brief The best moves of the earlier lines in multipv mode, skipped at the root
+    Move excludedRootMoves[MAX_MULTI_PV];
+    u8 excludedRootMoveCount = 0;
+
+    /// @brief The most pieces a position may have to be probed in the tablebases during search
+    u8 tbProbeLimit = TB_MAX_PIECES;
+
+    /// @brief The nodes searched, counted regardless of the debug metrics for the time manager
+    u64 nodes = 0;
+
+    /// @brief The nodes spent below the best root move of the current iteration
+    u64 bestRootMoveNodes = 0;
+
+    /// @brief Aborts the search once its hard limit is reached, unlimited if null
+    TimeManager* timeManager = nullptr;
+
+    /// @brief Set by another thread to abort the search, polled on every node. Ignored if null
+    std::atomic<bool>* stopSignal = nullptr;
+
+    /// @brief Whether the search was aborted, all scores returned after are meaningless
+    bool stopped = false;
+
     /* Only when _SearchOptions.debugMetrics is enabled */
     SearchMetrics metrics;
 };
 
-/// @brief The thread local object for fixed depth searches=
+/// @brief The thread local object for fixed depth searches
 template<StaticSearchOptions const& _SearchOptions>
 struct ThreadSearchState {
+    /// @brief Corrects the static eval used for pruning and the stand pat by the pawn structure
+    CorrectionHistory correctionHistory;
 
+    /// @brief Orders the quiet moves by the previous moves, on the heap as it is too large for a thread stack
+    std::unique_ptr<ContinuationHistory> continuationHistory = std::make_unique<ContinuationHistory>();
 };
 
 /// @brief The state object for an iterative search
@@ -114,6 +210,19 @@ struct IterativeSearchState {
 
     /// @brief Whether to end the search on this iteration
     bool end = false;
+
+    /// @brief The amount of best lines to search, each excluding the root moves of the ones before
+    u8 multiPV = 1;
+
+    /* Results of the last completed iteration */
+    u32 completedDepth = 0;
+    Move bestMove = NULL_MOVE;
+    i32 eval = 0; // RELATIVE to the side to move
+
+    /// @brief The root move and eval RELATIVE to the side to move of each line, best first
+    Move lineMoves[MAX_MULTI_PV];
+    i32 lineEvals[MAX_MULTI_PV];
+    u8 lineCount = 0;
 };
 
 struct SearchManager {
@@ -134,6 +243,76 @@ struct SearchManager {
     }
 };
 
+/// @brief Convert a score found at the given ply for the transposition table. Mate and tablebase scores
+/// count the plies from the root, in the table they count from the position itself so they stay right
+/// when the position is reached at another ply. Symmetric in the sign, so it works on absolute scores.
+forceinline i32 score_to_tt(i32 score, i32 ply) {
+    if (score > TB_RS) return score + ply;
+    if (score < -TB_RS) return score - ply;
+    return score;
+}
+
+/// @brief Convert a score from the transposition table back to the ply it is probed at, see score_to_tt.
+forceinline i32 score_from_tt(i32 score, i32 ply) {
+    if (score > TB_RS) return score - ply;
+    if (score < -TB_RS) return score + ply;
+    return score;
+}
+
+/// @brief Count a node and check whether the search has to be aborted. The stop signal is a relaxed load
+/// on every node, the clock is only looked at every TIME_CHECK_INTERVAL nodes so no syscall is made per node.
+template<StaticSearchOptions const& _SearchOptions, typename _Evaluator>
+forceinline bool search_check_stop(SearchState<_SearchOptions, _Evaluator>* state) {
+    if (state->stopSignal && state->stopSignal->load(std::memory_order_relaxed)) {
+        state->stopped = true;
+    } else if ((++state->nodes & (TIME_CHECK_INTERVAL - 1)) == 0 && state->timeManager && state->timeManager->hard_expired(state->nodes)) {
+        state->stopped = true;
+    }
+
+    return state->stopped;
+}
+
+/// @brief Prepare the state for searching the current root position, if the root is in the
+/// tablebases only the moves preserving the best result under the 50 move rule are kept.
+/// Further probing during the search is then disabled as all moves would score the same.
+template<StaticSearchOptions const& _SearchOptions, typename _Evaluator, Color turn>
+void search_prepare_root(SearchState<_SearchOptions, _Evaluator>* state) {
+    Board* board = state->board;
+    state->tbProbeLimit = TB_MAX_PIECES;
+
+    const VolatileBoardState* volatileState = board->volatile_state();
+    if (_popcount64(board->all_pieces()) > syzygy::max_pieces() ||
+        ((volatileState->castlingStatus[WHITE] | volatileState->castlingStatus[BLACK]) & (CAN_CASTLE_L | CAN_CASTLE_R))) {
+        return;
+    }
+
+    // collect the legal moves unless restricted already
+    const bool allMoves = state->rootMoveCount == 0;
+    if (allMoves) {
+        MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
+        gen_all_moves<decltype(moveList), movegenAllPL, turn>(board, &moveList);
+
+        for (u16 i = 0; i < moveList.count; i++) {
+            Move move = moveList.get_move(i);
+            if (move.null()) continue;
+
+            ExtMove<true> extMove(move);
+            board->make_move_unchecked<turn, true>(&extMove);
+            if (!board->is_in_check<turn>()) {
+                state->rootMoves[state->rootMoveCount++] = move;
+            }
+
+            board->unmake_move_unchecked<turn, true>(&extMove);
+        }
+    }
+
+    if (syzygy::filter_root_moves(board, state->rootMoves, &state->rootMoveCount)) {
+        state->tbProbeLimit = 0;
+    } else if (allMoves) {
+        state->rootMoveCount = 0;
+    }
+}
+
 /// @brief Search the current position to the given fixed depth
 /// @param state The search state
 /// The top level stack frame created by the root call has to be popped by the caller.
@@ -148,19 +327,44 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
 
     /* push the stack frame, this stack frame is expected to be popped by the caller */
     SearchStackFrame* frame = state->stack.push();
+    const Move excludedMove = frame->excludedMove;
+    const bool excluding = !excludedMove.null();
+    frame->parent = state->stack.size() == 1 ? nullptr : (excluding ? (frame - 1)->parent : frame - 1);
+    frame->ply = state->stack.size() == 1 ? 0 : (frame - 1)->ply + !excluding;
+    frame->staticEval = NULL_EVAL;
+    frame->reduction = 0;
+    frame->continuationHistory = nullptr;
+
+    if (search_check_stop(state)) {
+        return 0;
+    }
 
     Board* board = state->board;
+    frame->inCheck = board->is_in_check<turn>();
 
     constexpr i32 sign = -1 + 2 * turn; // the integer sign for the current turn, constexpr evaluated bc its a template arg
     
+    // the absolute static evaluation of this node, NULL_EVAL if not (yet) known
+    i32 staticEval = NULL_EVAL;
+
+    // function to convert the local eval into an absolute eval
+    auto absEval = [&](i32 eval) __attribute__((always_inline)) {
+        return sign * eval;
+    };
+
     // function to register the given eval to the tt
     auto addTT = [&](TTEntryType type, i32 depth, i32 eval) __attribute__((always_inline)) -> TTEntry* {
         if constexpr (!_SearchOptions.useTranspositionTable) {
             return nullptr;
         } 
 
+        // the result of a search excluding a move says nothing about the position itself
+        if (excluding || (frame->ply == 0 && state->excludedRootMoveCount > 0)) {
+            return nullptr;
+        }
+
         [[maybe_unused]] bool overwritten = false;
-        TTEntry* entry = state->transpositionTable->add(board, type, depth, eval, &overwritten);
+        TTEntry* entry = state->transpositionTable->add(board, type, depth, absEval(score_to_tt(eval, frame->ply)), staticEval, &overwritten);
 
         if (_SearchOptions.debugMetrics && entry) {
             state->metrics.ttWrites++;
@@ -172,15 +376,10 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         return entry;
     };
 
-    // function to convert the local eval into an absolute eval
-    auto absEval = [&](i32 eval) __attribute__((always_inline)) {
-        return sign * eval;
-    };
+    const i32 currentPositiveDepth = frame->ply; // starts at 0
 
-    const i32 currentPositiveDepth = state->maxPrimaryDepth - depthRemaining; // starts at 0
-
-    // check for 50 move rule draw
-    if (board->volatile_state()->rule50Ply >= 50) {
+    // check for 50 move rule draw, the root is always searched so there is a move to play
+    if (currentPositiveDepth > 0 && board->volatile_state()->rule50Ply >= 50) {
         if constexpr (_SearchOptions.debugMetrics) {
             state->metrics.rule50Draws += 1;
         }
@@ -188,13 +387,34 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         return EVAL_DRAW;
     }
 
+    // check for draws by repetition through the key history attached to the board
+    if (currentPositiveDepth > 0 && board->is_repetition(currentPositiveDepth)) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.repetitions += 1;
+        }
+
+        return EVAL_DRAW;
+    }
+
+    // if we can repeat a position with our next move the draw is the least we can get
+    if (currentPositiveDepth > 0 && alpha < EVAL_DRAW && board->has_upcoming_repetition(currentPositiveDepth)) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.upcomingRepetitions += 1;
+        }
+
+        alpha = EVAL_DRAW;
+        if (alpha >= beta) {
+            return beta;
+        }
+    }
+
     // check for king capture, should never occur during normal play
     if (board->kingIndexPerColor[!turn] == NULL_SQ) {
         return EVAL_WIN;
     }
 
     // check for material draw
-    if (board->is_insufficient_material()) {
+    if (currentPositiveDepth > 0 && board->is_insufficient_material()) {
         if constexpr (_SearchOptions.debugMetrics) {
             state->metrics.insufficientMaterial += 1;
         }
@@ -202,14 +422,81 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         return EVAL_DRAW;
     }
 
+    // our own tables know the exact distance to mate, but nothing about castling or en passant
+    const VolatileBoardState* volatileState = board->volatile_state();
+    const bool canCastle = (volatileState->castlingStatus[WHITE] | volatileState->castlingStatus[BLACK]) & (CAN_CASTLE_L | CAN_CASTLE_R);
+    if (currentPositiveDepth > 0 && _popcount64(board->all_pieces()) <= tbgen::max_pieces() &&
+        !canCastle && volatileState->enPassantTarget == NULL_SQ) {
+        i8 outcome;
+        u32 dtm;
+        if (tbgen::probe(board, &outcome, &dtm)) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.dtmHits++;
+            }
+
+            if (outcome == 0) return EVAL_DRAW;
+            return outcome > 0 ? -MATED_IN_PLY(currentPositiveDepth + dtm) : MATED_IN_PLY(currentPositiveDepth + dtm);
+        }
+    }
+
+    // king and pawn against king is decided exactly by the bitbase, no need to search the pawn race
+    if (currentPositiveDepth > 0 && _popcount64(board->all_pieces()) == 3 && board->pieces(PAWN)) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.bitbaseHits += 1;
+        }
+
+        const Color strongSide = IS_WHITE_PIECE(board->piece_on(_ctz64(board->pieces(PAWN))));
+        return sign * endgame::eval_kpk(board, strongSide);
+    }
+
+    // probe the tablebases right after a zeroing move, the tables know nothing about castling.
+    // wins and losses only bound the eval as the search may still find a mate, draws under
+    // the 50 move rule are scored just off the draw
+    i32 tbMinEval = EVAL_NEGATIVE_INFINITY;
+    i32 tbMaxEval = EVAL_POSITIVE_INFINITY;
+    if (currentPositiveDepth > 0 && volatileState->rule50Ply == 0 &&
+        _popcount64(board->all_pieces()) <= MIN(state->tbProbeLimit, syzygy::max_pieces()) && !canCastle) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.tbProbes++;
+        }
+
+        syzygy::ProbeState result;
+        const syzygy::WDLScore wdl = syzygy::probe_wdl(board, &result);
+        if (result != syzygy::PROBE_FAIL) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.tbHits++;
+            }
+
+            if (wdl == syzygy::WDL_WIN) {
+                tbMinEval = EVAL_TB_WIN - currentPositiveDepth;
+                alpha = std::max(alpha, tbMinEval);
+            } else if (wdl == syzygy::WDL_LOSS) {
+                tbMaxEval = -EVAL_TB_WIN + currentPositiveDepth;
+                beta = std::min(beta, tbMaxEval);
+            } else {
+                return EVAL_DRAW + wdl;
+            }
+
+            if (alpha >= beta) {
+                return wdl == syzygy::WDL_WIN ? tbMinEval : tbMaxEval;
+            }
+        }
+    }
+
     i32 oldAlpha = alpha;
 
     // transposition table lookup
     TTEntry* ttEntry = nullptr;
+    i32 ttScore = 0; // the score of the entry relative to the side to move at this ply
     if constexpr (_SearchOptions.useTranspositionTable) {
-        // try lookup in tt
-        ttEntry = state->transpositionTable->get(board);
-        if (ttEntry->depth >= depthRemaining) {
+        // try lookup in tt, the entry belongs to the search including the excluded move. the root is
+        // always searched, the table outlives a search so it may hold the root from an earlier one
+        ttEntry = excluding ? nullptr : state->transpositionTable->get(board);
+        if (ttEntry) {
+            ttScore = score_from_tt(sign * ttEntry->score, currentPositiveDepth);
+        }
+
+        if (ttEntry && ttEntry->depth >= depthRemaining && currentPositiveDepth > 0) {
             switch (ttEntry->type) {
                 case TT_PV: {
                     if constexpr (_SearchOptions.debugMetrics) {
@@ -217,11 +504,11 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
                     }
 
                     frame->move = ttEntry->data.move;
-                    return sign * ttEntry->score;
+                    return ttScore;
                 } break;
 
-                case TT_LOWER_BOUND: alpha = std::max(alpha, ttEntry->score); break;
-                case TT_UPPER_BOUND: beta = std::min(beta, ttEntry->score); break;
+                case TT_LOWER_BOUND: alpha = std::max(alpha, ttScore); break;
+                case TT_UPPER_BOUND: beta = std::min(beta, ttScore); break;
                 default: break; // also covers TT_NULL
             }
 
@@ -236,11 +523,144 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         }
     }
     
-    // initialize move picker
+    // determine the static eval of this node, reusing the one stored in the
+    // tt entry if available so pruning decisions dont need a fresh evaluation
+    if (!frame->inCheck) {
+        if (_SearchOptions.useTranspositionTable && ttEntry && ttEntry->staticEval != NULL_EVAL) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.ttStaticEvalHits++;
+            }
+
+            staticEval = ttEntry->staticEval;
+        } else {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.staticEvals++;
+            }
+
+            staticEval = state->leafEval->eval(board);
+        }
+    }
+
+    // the static eval RELATIVE to us corrected by the pawn structure history, used for pruning
+    const i32 correctedEval = staticEval != NULL_EVAL ? threadState->correctionHistory.correct(board, turn, sign * staticEval) : NULL_EVAL;
+    frame->staticEval = correctedEval;
+
+    // whether the static eval went up since our last move, compared to four plies up if we were
+    // in check two plies up. positions which are getting better for us are pruned more eagerly
+    bool improving = false;
+    if (correctedEval != NULL_EVAL) {
+        const SearchStackFrame* before = frame->parent ? frame->parent->parent : nullptr;
+        if (before && before->staticEval == NULL_EVAL) {
+            before = before->parent ? before->parent->parent : nullptr;
+        }
+
+        improving = !before || before->staticEval == NULL_EVAL || correctedEval > before->staticEval;
+    }
+
+    // reverse futility pruning, when the static eval is far enough above beta at a low
+    // remaining depth we assume the opponent has already avoided this line
+    if (currentPositiveDepth > 0 && !excluding && correctedEval != NULL_EVAL && depthRemaining <= RFP_MAX_DEPTH &&
+        beta < EVAL_KNOWN_WIN && beta > -EVAL_KNOWN_WIN && correctedEval - RFP_MARGIN * (depthRemaining - improving) >= beta) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.prunes++;
+            state->metrics.reverseFutilityPrunes++;
+        }
+
+        return beta;
+    }
+
+    // probcut, a capture winning enough material that a reduced search fails high a margin above
+    // beta would most likely fail high at full depth as well. the capture is first verified by
+    // a qsearch, only nodes with a bounded beta are tried so the leftmost path stays exact
+    if (currentPositiveDepth > 0 && !excluding && correctedEval != NULL_EVAL && depthRemaining >= PROBCUT_MIN_DEPTH &&
+        beta < EVAL_KNOWN_WIN && beta > -EVAL_KNOWN_WIN &&
+        !(ttEntry && ttEntry->type != TT_LOWER_BOUND && ttEntry->depth + 3 >= depthRemaining &&
+          ttScore < beta + PROBCUT_MARGIN - improving * PROBCUT_IMPROVING_DISCOUNT)) {
+        const i32 probBeta = beta + PROBCUT_MARGIN - improving * PROBCUT_IMPROVING_DISCOUNT;
+        const i32 seeThreshold = std::max(probBeta - correctedEval, 1);
+
+        MoveSupplier captureSupplier(board);
+        for (Move move = captureSupplier.next_capture<turn>(); !move.null(); move = captureSupplier.next_capture<turn>()) {
+            if (!see_ge(board, move, seeThreshold)) {
+                continue;
+            }
+
+            ExtMove<true> extMove(move);
+            board->make_move_unchecked<turn, true>(&extMove);
+            if (board->is_in_check<turn>()) {
+                board->unmake_move_unchecked<turn, true>(&extMove);
+                continue;
+            }
+
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.probCutSearches++;
+            }
+
+            frame->move = move;
+            frame->continuationHistory = threadState->continuationHistory->get(extMove.piece, move.dst);
+            i32 evalForUs = -qsearch<_SearchOptions, _Evaluator, !turn>(state, threadState, -probBeta, -probBeta + 1, currentPositiveDepth + 1, 0);
+            if (evalForUs >= probBeta) {
+                evalForUs = -search_sync<_SearchOptions, _Evaluator, !turn>(state, threadState, -probBeta, -probBeta + 1, depthRemaining - PROBCUT_REDUCTION);
+                state->stack.pop();
+            }
+
+            board->unmake_move_unchecked<turn, true>(&extMove);
+            if (state->stopped) {
+                return 0;
+            }
+
+            if (evalForUs >= probBeta) {
+                if constexpr (_SearchOptions.debugMetrics) {
+                    state->metrics.prunes++;
+                    state->metrics.probCuts++;
+                }
+
+                TTEntry* entry = addTT(TT_LOWER_BOUND, depthRemaining - PROBCUT_REDUCTION + 1, evalForUs);
+                if (entry) {
+                    entry->data.move = move;
+                }
+
+                return beta;
+            }
+        }
+    }
+
+    // function to learn the difference between the search score and the static eval, skipped when
+    // a capture decided the score or the bound says nothing about the direction of the difference
+    auto updateCorrection = [&](TTEntryType type, bool capture, i32 score) __attribute__((always_inline)) {
+        if (staticEval == NULL_EVAL || excluding || capture || score >= EVAL_KNOWN_WIN || score <= -EVAL_KNOWN_WIN) return;
+        if (type == TT_LOWER_BOUND && score <= correctedEval) return;
+        if (type == TT_UPPER_BOUND && score >= correctedEval) return;
+        threadState->correctionHistory.update(board, turn, depthRemaining, score, sign * staticEval);
+    };
+
+    // initialize move picker, ordering the quiets by how they did as replies to the last moves
     MoveSupplier moveSupplier(board);
+    if (frame->parent) {
+        moveSupplier.continuationHistories[0] = frame->parent->continuationHistory;
+        if (frame->parent->parent) {
+            moveSupplier.continuationHistories[1] = frame->parent->parent->continuationHistory;
+        }
+    }
+
+    // function to reward or penalize a quiet move in the continuation histories of the last moves
+    auto updateContinuation = [&](Piece piece, Sq dst, i32 bonus) __attribute__((always_inline)) {
+        const i32 index = PIECE_HISTORY_INDEX(piece);
+        for (PieceToHistory* history : moveSupplier.continuationHistories) {
+            if (history) {
+                ContinuationHistory::update(&(*history)[index][dst], bonus);
+            }
+        }
+    };
+
+    // the quiet moves searched so far without a cutoff
+    Move quietsTried[MAX_TRACKED_QUIETS];
+    Piece quietPiecesTried[MAX_TRACKED_QUIETS];
+    u8 quietsTriedCount = 0;
 
     // check for hash moves, we can cut movegen if this move
     // cuts this node with pruning
+    Move ttMove = NULL_MOVE;
     if (_SearchOptions.useTranspositionTable && ttEntry) {
         if (board->check_pseudo_legal<turn>(ttEntry->data.move)) {
             if constexpr (_SearchOptions.debugMetrics) {
@@ -248,19 +668,80 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
             }
 
             moveSupplier.init_tt(ttEntry);
+            ttMove = ttEntry->data.move;
+        }
+    }
+
+    // internal iterative reduction, without a tt move the ordering at this node is poor and the
+    // search is likely to be wasted, so search it shallower. this also stores a tt move for the
+    // next iteration, which then searches the node at full depth with a good first move
+    if (currentPositiveDepth > 0 && !excluding && ttMove.null() && depthRemaining >= IIR_MIN_DEPTH) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.iirReductions++;
+        }
+
+        depthRemaining--;
+        frame->reduction++;
+    }
+
+    // singular extension, when the tt score is a deep enough lower bound search the other moves at a
+    // reduced depth against a null window just below its score. if they all fail low the tt move is
+    // the only one holding the position and is extended, if they fail high even above beta there
+    // are multiple moves refuting the parent so the node is cut
+    i32 ttMoveExtension = 0;
+    if (currentPositiveDepth > 0 && !ttMove.null() && depthRemaining >= SINGULAR_MIN_DEPTH &&
+        (ttEntry->type == TT_LOWER_BOUND || ttEntry->type == TT_PV) && ttEntry->depth + SINGULAR_TT_DEPTH_SLACK >= depthRemaining &&
+        currentPositiveDepth < 2 * (i32)state->maxPrimaryDepth && state->stack.size() + 2 * depthRemaining < MAX_DEPTH) {
+        if (ttScore < EVAL_KNOWN_WIN && ttScore > -EVAL_KNOWN_WIN) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.singularSearches++;
+            }
+
+            const i32 singularBeta = ttScore - SINGULAR_MARGIN * depthRemaining;
+            SearchStackFrame* next = frame + 1;
+            next->excludedMove = ttMove;
+            const i32 singularEval = search_sync<_SearchOptions, _Evaluator, turn>(state, threadState, singularBeta - 1, singularBeta, (depthRemaining - 1) / 2);
+            state->stack.pop();
+            next->excludedMove = NULL_MOVE;
+            if (state->stopped) {
+                return 0;
+            }
+
+            if (singularEval < singularBeta) {
+                if constexpr (_SearchOptions.debugMetrics) {
+                    state->metrics.singularExtensions++;
+                }
+
+                ttMoveExtension = 1;
+            } else if (singularBeta >= beta) {
+                if constexpr (_SearchOptions.debugMetrics) {
+                    state->metrics.prunes++;
+                    state->metrics.multiCuts++;
+                }
+
+                return beta;
+            }
         }
     }
 
     // track the best known move and its eval
     i32 bestEval = EVAL_NEGATIVE_INFINITY;
     Move bestMove = NULL_MOVE;
+    bool bestIsCapture = false;
 
     i32 legalMoves = 0;
 
     /* main move search loop */
     while (moveSupplier.has_next()) {
         Move move = moveSupplier.next_move<turn>();
-        if (move.null()) continue;
+        if (move.null() || move.eq(excludedMove)) continue;
+
+        // skip moves excluded from the root, or already the best move of an earlier line
+        if (currentPositiveDepth == 0 &&
+            ((state->rootMoveCount > 0 && std::none_of(state->rootMoves, state->rootMoves + state->rootMoveCount, [&](Move m) { return m.eq(move); })) ||
+             std::any_of(state->excludedRootMoves, state->excludedRootMoves + state->excludedRootMoveCount, [&](Move m) { return m.eq(move); }))) {
+            continue;
+        }
 
         ExtMove<true> extMove(move);
         board->make_move_unchecked<turn, true>(&extMove);
@@ -283,13 +764,18 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         }
 
         frame->move = move;
+        frame->continuationHistory = threadState->continuationHistory->get(extMove.piece, move.dst);
+        const bool quiet = extMove.captured == NULL_PIECE && !move.is_promotion() && !move.is_en_passant();
 
-        u16 nextDepth = depthRemaining - 1;
+        // only the move returned by the tt stage is extended, it is generated again later on
+        const bool isTTMove = moveSupplier.stage == CAPTURES_INIT && move.eq(ttMove);
+        u16 nextDepth = depthRemaining - 1 + (isTTMove ? ttMoveExtension : 0);
 
         // register legal move
         legalMoves++;
 
         // perform search on move
+        const u64 nodesBefore = state->nodes;
         i32 evalForUs;
         if (nextDepth == 0) {
             // evaluate leaf
@@ -300,9 +786,20 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
             state->stack.pop();
         }
 
+        // the score of an aborted search is meaningless, leave without storing anything
+        if (state->stopped) {
+            board->unmake_move_unchecked<turn, true>(&extMove);
+            return 0;
+        }
+
         if (evalForUs > bestEval) {
             bestMove = move;
             bestEval = evalForUs;
+            bestIsCapture = extMove.captured != NULL_PIECE;
+
+            if (currentPositiveDepth == 0 && !excluding) {
+                state->bestRootMoveNodes = state->nodes - nodesBefore;
+            }
         }
 
         // check for new alpha
@@ -328,12 +825,28 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
 
                 // unmake move
                 board->unmake_move_unchecked<turn, true>(&extMove);
+                updateCorrection(TT_LOWER_BOUND, bestIsCapture, alpha);
+
+                // the quiet move refuting the previous moves is tried earlier next time, the others later
+                if (quiet) {
+                    const i32 bonus = ContinuationHistory::bonus(depthRemaining);
+                    updateContinuation(extMove.piece, move.dst, bonus);
+                    for (u8 i = 0; i < quietsTriedCount; i++) {
+                        updateContinuation(quietPiecesTried[i], quietsTried[i].dst, -bonus);
+                    }
+                }
+
                 return beta;
             }
         }
 
         // unmake move
         board->unmake_move_unchecked<turn, true>(&extMove);
+
+        if (quiet && quietsTriedCount < MAX_TRACKED_QUIETS) {
+            quietsTried[quietsTriedCount] = move;
+            quietPiecesTried[quietsTriedCount++] = extMove.piece;
+        }
     }
 
     if constexpr (_SearchOptions.debugMetrics) {
@@ -351,6 +864,11 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
         }
     }
 
+    // the excluded move was the only legal one, so no other move reaches the bound
+    if (excluding && legalMoves == 0) {
+        return alpha;
+    }
+
     // evaluate stalemate or checkmate
     if (legalMoves == 0) {
         // evaluate checkmate
@@ -381,16 +899,18 @@ i32 search_sync(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchStat
     }   
     
     // store evaluation and move in tt
+    const TTEntryType type = alpha <= oldAlpha ? TT_UPPER_BOUND : TT_PV;
     if constexpr (_SearchOptions.useTranspositionTable) {
-        const TTEntryType type = alpha <= oldAlpha ? TT_UPPER_BOUND : TT_PV;
         TTEntry* entry = addTT(type, depthRemaining, alpha);
         if (entry) {
             entry->data.move = bestMove;
         }
     }
 
+    updateCorrection(type, bestIsCapture, bestEval);
+
     frame->move = bestMove;
-    return bestEval;
+    return std::clamp(bestEval, tbMinEval, tbMaxEval);
 }
 
 /// @brief Root node quesience search, used when depth 0 is reached in the main search
@@ -398,16 +918,21 @@ template<StaticSearchOptions const& _SearchOptions, typename _Evaluator, Color t
 i32 qsearch_root(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchState<_SearchOptions>* threadState, 
                  i32 alpha, i32 beta, i32 positiveDepth) {
 
-    return qsearch<_SearchOptions, _Evaluator, turn>(state, threadState, alpha, beta, positiveDepth);
+    return qsearch<_SearchOptions, _Evaluator, turn>(state, threadState, alpha, beta, positiveDepth, 0);
 }
 
 /// @brief Quesience search, used when depth 0 is reached in the main search
+/// @param qsearchPly The distance to the node the quiescence search was entered at.
 template<StaticSearchOptions const& _SearchOptions, typename _Evaluator, Color turn>
 i32 qsearch(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchState<_SearchOptions>* threadState, 
-            i32 alpha, i32 beta, i32 positiveDepth) {
+            i32 alpha, i32 beta, i32 positiveDepth, i32 qsearchPly) {
 
     Board* board = state->board;
 
+    if (search_check_stop(state)) {
+        return 0;
+    }
+
     if constexpr (_SearchOptions.debugMetrics) {
         state->metrics.totalNodes++;
         state->metrics.totalQuiescenceNodes++;
@@ -417,21 +942,75 @@ i32 qsearch(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchState<_S
         }
     }
 
-    // generate and iterate captures
-    MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
-    gen_all_moves<decltype(moveList), movegenCapturesPL, turn>(board, &moveList);
+    constexpr i32 sign = turn == WHITE ? 1 : -1;
+
+    // evasions are only searched close to the horizon, further down checks would keep the tree
+    // growing, so there the side in check stands pat and looks at captures like any other node
+    const bool evasions = board->is_in_check<turn>() && qsearchPly < QSEARCH_EVASION_PLIES;
+
+    // stand pat on the corrected static eval, we are not forced to capture
+    // when not in check, so it bounds our eval from below
+    i32 bestEval = EVAL_NEGATIVE_INFINITY;
+    if (!evasions) {
+        _Evaluator* eval = state->leafEval;
+        i32 staticEval;
+        if constexpr (requires { eval->eval(board, alpha, beta); }) {
+            // lazy evaluation against the ABSOLUTE window
+            staticEval = sign * eval->eval(board, turn == WHITE ? alpha : -beta, turn == WHITE ? beta : -alpha);
+        } else {
+            staticEval = sign * eval->eval(board);
+        }
+
+        bestEval = threadState->correctionHistory.correct(board, turn, staticEval);
+        if (bestEval >= beta) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.totalLeafNodes++;
+            }
+
+            return bestEval;
+        }
+
+        alpha = std::max(alpha, bestEval);
+    }
+
+    // the tt move of an earlier search of this position is tried first
+    Move ttMove = NULL_MOVE;
+    if constexpr (_SearchOptions.useTranspositionTable) {
+        TTEntry* entry = state->transpositionTable->get(board);
+        if (entry && entry->type != TT_UPPER_BOUND) {
+            ttMove = entry->data.move;
+        }
+    }
+
+    // generate captures, or all evasions when in check, ordered by mvv-lva
+    MoveList<BasicScoreMoveOrderer, MAX_MOVES> moveList;
+    if (evasions) {
+        gen_all_moves<decltype(moveList), movegenAllPL, turn>(board, &moveList);
+    } else {
+        gen_all_moves<decltype(moveList), movegenCapturesPL, turn>(board, &moveList);
+    }
+
+    moveList.sort_moves<turn>(board, [&](Move move) { return move.eq(ttMove) ? 20000 : 0; });
 
     if constexpr (_SearchOptions.debugMetrics) {
         state->metrics.totalPseudoLegal += moveList.count;
     }
 
-    // iterate legal captures
-    i32 bestEval = 0;
+    // iterate legal moves
     i32 legalMoves = 0;
     for (i32 i = moveList.count - 1; i >= 0; i--) {
         Move move = moveList.get_move(i);
         if (move.null()) continue;
 
+        // captures losing material can not raise the stand pat
+        if (!evasions && !see_ge(board, move, 0)) {
+            if constexpr (_SearchOptions.debugMetrics) {
+                state->metrics.qsearchSeePrunes++;
+            }
+
+            continue;
+        }
+
         ExtMove<true> extMove(move);
         board->make_move_unchecked<turn, true>(&extMove);
 
@@ -444,17 +1023,20 @@ i32 qsearch(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchState<_S
         legalMoves++;
 
         // perform deeper qsearch
-        i32 eval = -qsearch<_SearchOptions, _Evaluator, !turn>(state, threadState, -beta, -alpha, positiveDepth + 1);
+        i32 eval = -qsearch<_SearchOptions, _Evaluator, !turn>(state, threadState, -beta, -alpha, positiveDepth + 1, qsearchPly + 1);
         if (eval > bestEval) {
             bestEval = eval;
         }
 
         board->unmake_move_unchecked<turn, true>(&extMove);
+        if (state->stopped) {
+            return 0;
+        }
 
         if (eval > alpha) {
             alpha = eval;
-            if (alpha > beta) {
-                return beta;
+            if (alpha >= beta) {
+                break;
             }
         }
     }
@@ -463,54 +1045,147 @@ i32 qsearch(SearchState<_SearchOptions, _Evaluator>* state, ThreadSearchState<_S
         state->metrics.totalLegalMoves += legalMoves;
     }
 
-    if (legalMoves > 0) {
-        return bestEval;
-    }
+    // all moves were generated when in check, so no legal move is checkmate
+    if (evasions && legalMoves == 0) {
+        if constexpr (_SearchOptions.debugMetrics) {
+            state->metrics.totalLeafNodes++;
+        }
 
-    if constexpr (_SearchOptions.debugMetrics) {
-        state->metrics.totalLeafNodes++;
+        return MATED_IN_PLY(/* current positive depth */ positiveDepth);
     }
 
-    // no legal captures, check for legal quiets to find checkmate
-    moveList.reset();
-    gen_all_moves<decltype(moveList), movegenQuietsPL, turn>(board, &moveList);
+    return bestEval;
+}
 
-    if constexpr (_SearchOptions.debugMetrics) {
-        state->metrics.totalPseudoLegal += moveList.count;
+/// @brief The amount of legal moves searched at the root.
+template<StaticSearchOptions const& _SearchOptions, typename _Evaluator, Color turn>
+u16 search_count_root_moves(SearchState<_SearchOptions, _Evaluator>* state) {
+    if (state->rootMoveCount > 0) {
+        return state->rootMoveCount;
     }
 
-    for (i32 i = moveList.count - 1; i >= 0; i--) {
+    Board* board = state->board;
+    MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
+    gen_all_moves<decltype(moveList), movegenAllPL, turn>(board, &moveList);
+
+    u16 count = 0;
+    for (u16 i = 0; i < moveList.count; i++) {
         Move move = moveList.get_move(i);
         if (move.null()) continue;
 
         ExtMove<true> extMove(move);
         board->make_move_unchecked<turn, true>(&extMove);
-
-        // check whether the move is legal
-        if (!board->is_in_check<turn>()) {
-            legalMoves++;
-        }
-        
+        count += !board->is_in_check<turn>();
         board->unmake_move_unchecked<turn, true>(&extMove);
     }
 
-    if (legalMoves == 0) {
-        if (board->is_in_check<turn>()) {
-            return MATED_IN_PLY(/* current positive depth */ positiveDepth);
+    return count;
+}
+
+/// @brief Search the current position with iterative deepening until the depth limit is reached or the
+/// time manager attached to the search state ends it. The results of an aborted iteration are discarded.
+/// In multipv mode every iteration searches the root once per line, each time without the best moves
+/// of the lines before, the later lines are cheap as they find the tree in the transposition table.
+/// @param maxDepth The deepest iteration to search.
+/// @param onIteration Called with the iterative state after every completed iteration.
+template<StaticSearchOptions const& _SearchOptions, typename _Evaluator, Color turn, typename _Callback>
+void search_iterative(IterativeSearchState<_SearchOptions, _Evaluator>* iterState, ThreadSearchState<_SearchOptions>* threadState,
+                      u32 maxDepth, _Callback onIteration) {
+    SearchState<_SearchOptions, _Evaluator>* state = &iterState->searchState;
+    state->nodes = 0;
+    state->stopped = false;
+    search_prepare_root<_SearchOptions, _Evaluator, turn>(state);
+
+    // there can not be more lines than moves at the root
+    const u32 rootMoveCount = search_count_root_moves<_SearchOptions, _Evaluator, turn>(state);
+    const u8 lineCount = (u8)MAX(MIN((u32)MIN(iterState->multiPV, (u8)MAX_MULTI_PV), rootMoveCount), 1u);
+
+    // the first iteration is always completed so there is a move to play
+    TimeManager* timeManager = state->timeManager;
+    std::atomic<bool>* stopSignal = state->stopSignal;
+    state->timeManager = nullptr;
+    state->stopSignal = nullptr;
+
+    for (u32 depth = 1; depth <= MIN(maxDepth, (u32)MAX_DEPTH / 2) && !iterState->end; depth++) {
+        const u64 nodesBefore = state->nodes;
+        state->maxPrimaryDepth = depth;
+
+        Move lineMoves[MAX_MULTI_PV];
+        i32 lineEvals[MAX_MULTI_PV];
+        u64 bestMoveNodes = 0, firstLineNodes = 0;
+        state->excludedRootMoveCount = 0;
+        for (u8 line = 0; line < lineCount && !state->stopped; line++) {
+            state->bestRootMoveNodes = 0;
+            lineEvals[line] = search_sync<_SearchOptions, _Evaluator, turn>(state, threadState, EVAL_NEGATIVE_INFINITY, EVAL_POSITIVE_INFINITY, depth);
+            lineMoves[line] = state->stack.first()->move;
+            state->stack.pop();
+            state->excludedRootMoves[state->excludedRootMoveCount++] = lineMoves[line];
+
+            if (line == 0) {
+                bestMoveNodes = state->bestRootMoveNodes;
+                firstLineNodes = state->nodes - nodesBefore;
+            }
         }
 
-        return EVAL_DRAW;
+        state->excludedRootMoveCount = 0;
+        state->timeManager = timeManager;
+        state->stopSignal = stopSignal;
+
+        if (state->stopped) {
+            break;
+        }
+
+        // a later line may score better than an earlier one as the earlier searches were shallower
+        // with respect to the tt, keep them sorted best first
+        u8 order[MAX_MULTI_PV];
+        for (u8 i = 0; i < lineCount; i++) order[i] = i;
+        std::stable_sort(order, order + lineCount, [&](u8 a, u8 b) { return lineEvals[a] > lineEvals[b]; });
+        for (u8 i = 0; i < lineCount; i++) {
+            iterState->lineMoves[i] = lineMoves[order[i]];
+            iterState->lineEvals[i] = lineEvals[order[i]];
+        }
+
+        iterState->lineCount = lineCount;
+        iterState->completedDepth = depth;
+        iterState->bestMove = iterState->lineMoves[0];
+        iterState->eval = iterState->lineEvals[0];
+        onIteration(iterState);
+
+        if (timeManager && timeManager->should_stop(iterState->bestMove, bestMoveNodes, firstLineNodes)) {
+            iterState->end = true;
+        }
     }
+}
 
-    if constexpr (_SearchOptions.debugMetrics) {
-        state->metrics.totalLegalMoves += legalMoves;
+/// @brief Follow the tt moves from the current position, starting with the given move, to collect the principal
+/// variation. Stops at the first move which is not legal, as the entry may belong to another position, or which
+/// repeats a position of the variation.
+/// @return The length of the variation written to pv.
+template<Color turn>
+u32 search_collect_pv(TranspositionTable* tt, Board* board, Move move, Move* pv, u32 length, u32 maxLength) {
+    if (length >= maxLength || move.null()) {
+        return length;
+    }
+
+    MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
+    gen_all_moves<decltype(moveList), movegenAllPL, turn>(board, &moveList);
+    if (std::none_of(moveList.moves, moveList.moves + moveList.count, [&](MoveScorePair const& m) { return m.move.eq(move); })) {
+        return length;
+    }
+
+    ExtMove<true> extMove(move);
+    board->make_move_unchecked<turn, true>(&extMove);
+    if (!board->is_in_check<turn>() && !board->is_repetition(length + 1)) {
+        pv[length++] = move;
+
+        TTEntry* entry = tt->get(board);
+        if (entry && entry->type != TT_UPPER_BOUND) {
+            length = search_collect_pv<!turn>(tt, board, entry->data.move, pv, length, maxLength);
+        }
     }
-    
-    // statically evaluate position
-    constexpr i32 sign = turn == WHITE ? 1 : -1;
 
-    _Evaluator* eval = state->leafEval;
-    return sign * eval->eval(state->board);
+    board->unmake_move_unchecked<turn, true>(&extMove);
+    return length;
 }
 
 inline u8 SearchStack::size() {
@@ -545,6 +1220,7 @@ static void debug_tostr_search_metrics(std::ostream& os, SearchState<_SearchOpti
     os << " Checkmates: " << state->metrics.checkmates << "\n";
     os << " Stalemates: " << state->metrics.stalemates << "\n";
     os << " Insufficient Material: " << state->metrics.insufficientMaterial << "\n";
+    os << " Repetitions: " << state->metrics.repetitions << " (" << state->metrics.upcomingRepetitions << " upcoming)\n";
     os << " Pseudo-legal generated: " << state->metrics.totalPseudoLegal << "\n";
     os << " Total legal moves iterated: " << state->metrics.totalLegalMoves << "\n";
     os << " Illegal Discarded: " << state->metrics.illegal << "\n";
@@ -554,7 +1230,16 @@ static void debug_tostr_search_metrics(std::ostream& os, SearchState<_SearchOpti
         os << " TT Overwrites: " << state->metrics.ttOverwrites << " (" << (state->metrics.ttWrites > 0 ? (((float)state->metrics.ttOverwrites / (float)state->metrics.ttWrites) * 100) : 0) << "%)\n";  
         os << " TT Used: " << state->transpositionTable->used << " (" << (((float)(state->transpositionTable->used) / (float)(state->transpositionTable->capacity)) * 100) << "% full)\n";
         os << " TT Hash Move Hits: " << state->metrics.ttHashMoves << " (" << state->metrics.ttHashMovePrunes << " prunes)\n";
+        os << " TT Static Eval Hits: " << state->metrics.ttStaticEvalHits << "\n";
     }
+    os << " Interior Static Evals: " << state->metrics.staticEvals << "\n";
+    os << " Reverse Futility Prunes: " << state->metrics.reverseFutilityPrunes << "\n";
+    os << " IIR Reductions: " << state->metrics.iirReductions << "\n";
+    os << " ProbCuts: " << state->metrics.probCuts << " (" << state->metrics.probCutSearches << " searches)\n";
+    os << " Singular Extensions: " << state->metrics.singularExtensions << " (" << state->metrics.singularSearches << " searches, " << state->metrics.multiCuts << " multi-cuts)\n";
+    os << " Bitbase Hits: " << state->metrics.bitbaseHits << "\n";
+    os << " TB Hits: " << state->metrics.tbHits << " (" << state->metrics.tbProbes << " probes)\n";
+    os << " DTM Hits: " << state->metrics.dtmHits << "\n";
 }
 
 }
\ No newline at end of file
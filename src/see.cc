@@ -0,0 +1,75 @@
+#include "see.hh"
+
+namespace tc {
+
+bool see_ge(Board* board, Move move, i32 threshold) {
+    if (move.is_castle() || move.is_en_passant() || move.is_promotion()) {
+        return threshold <= 0;
+    }
+
+    const Sq src = move.src;
+    const Sq dst = move.dst;
+
+    // the gain after the move if it is not recaptured, and the loss if it is
+    i32 swap = seeValuePerType[TYPE_OF_PIECE(board->piece_on(dst))] - threshold;
+    if (swap < 0) {
+        return false;
+    }
+
+    swap = seeValuePerType[TYPE_OF_PIECE(board->piece_on(src))] - swap;
+    if (swap <= 0) {
+        return true;
+    }
+
+    Bitboard occupied = board->all_pieces() ^ (1ULL << src) ^ (1ULL << dst);
+    const Bitboard diagonal = board->pieces(BISHOP) | board->pieces(QUEEN);
+    const Bitboard straight = board->pieces(ROOK) | board->pieces(QUEEN);
+    Bitboard attackers = (lookup::pawnAttackBBs.values[BLACK][dst] & board->pieces(WHITE, PAWN)) |
+                         (lookup::pawnAttackBBs.values[WHITE][dst] & board->pieces(BLACK, PAWN)) |
+                         (lookup::knightAttackBBs.values[dst] & board->pieces(KNIGHT)) |
+                         (lookup::kingMovementBBs.values[dst] & board->pieces(KING)) |
+                         (lookup::magic::bishop_attack_bb(dst, occupied) & diagonal) |
+                         (lookup::magic::rook_attack_bb(dst, occupied) & straight);
+
+    Color turn = IS_WHITE_PIECE(board->piece_on(src));
+    bool result = true;
+    while (true) {
+        turn = !turn;
+        attackers &= occupied;
+
+        const Bitboard ourAttackers = attackers & board->pieces_for_side(turn);
+        if (!ourAttackers) {
+            break;
+        }
+
+        result = !result;
+
+        // recapture with the least valuable attacker, which may reveal sliders behind it
+        PieceType pt = PAWN;
+        while (!(ourAttackers & board->pieces(turn, pt))) {
+            pt = (PieceType)(pt + 1);
+        }
+
+        if (pt == KING) {
+            // the king may only capture when the square is not defended anymore
+            return (attackers & ~board->pieces_for_side(turn)) ? !result : result;
+        }
+
+        if ((swap = seeValuePerType[pt] - swap) < result) {
+            break;
+        }
+
+        occupied ^= 1ULL << _ctz64(ourAttackers & board->pieces(turn, pt));
+        if (pt == PAWN || pt == BISHOP || pt == QUEEN) {
+            attackers |= lookup::magic::bishop_attack_bb(dst, occupied) & diagonal;
+        }
+
+        if (pt == ROOK || pt == QUEEN) {
+            attackers |= lookup::magic::rook_attack_bb(dst, occupied) & straight;
+        }
+    }
+
+    return result;
+}
+
+}
\ No newline at end of file
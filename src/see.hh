@@ -0,0 +1,29 @@
+#pragma once
+
+#include "board.hh"
+#include "evaldef.hh"
+
+/*
+    Static exchange evaluation, the material balance of the capture sequence on the destination
+    square of a move when both sides always recapture with their least valuable attacker and
+    may stop whenever continuing would lose material. Pins and checks are not considered.
+ */
+
+namespace tc {
+
+/// @brief The values of the piece types used in the exchanges.
+static const i32 seeValuePerType[] = {
+    iEval(1.0), // Pawn
+    iEval(3.0), // Knight
+    iEval(3.0), // Bishop
+    iEval(5.0), // Rook
+    iEval(9.0), // Queen
+    0,          // King, a capture by the king ends the sequence
+    0,          // NULL aka COUNT
+};
+
+/// @brief Check whether the static exchange evaluation of the given move, for the side making
+/// it, is at least the given threshold. Special moves are counted as exchanging nothing.
+bool see_ge(Board* board, Move move, i32 threshold);
+
+}
\ No newline at end of file
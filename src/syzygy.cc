@@ -0,0 +1,1137 @@
+#include "syzygy.hh"
+#include "board.hh"
+#include "movegen.hh"
+#include "logging.hh"
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <string.h>
+
+namespace tc::syzygy {
+
+// large enough for any DTZ value stored in the tables
+#define TB_MAX_DTZ (1 << 18)
+
+enum TableType { TB_WDL, TB_DTZ };
+
+// the flags of a table, all but TB_FLAG_SINGLE_VALUE only apply to DTZ tables
+enum TableFlag : u8 {
+    TB_FLAG_STM          = 1,
+    TB_FLAG_MAPPED       = 2,
+    TB_FLAG_WIN_PLIES    = 4,
+    TB_FLAG_LOSS_PLIES   = 8,
+    TB_FLAG_WIDE         = 16,
+    TB_FLAG_SINGLE_VALUE = 128
+};
+
+static const u8 wdlMagic[4] = { 0x71, 0xE8, 0x23, 0x5D };
+static const u8 dtzMagic[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+/* Reading the file, the tables mix little and big endian numbers
+   and only x86 hosts are supported so little endian is native */
+
+template<typename T>
+forceinline T read_le(const void* addr) {
+    T v;
+    memcpy(&v, addr, sizeof(T));
+    return v;
+}
+
+forceinline u32 read_be32(const void* addr) { return __builtin_bswap32(read_le<u32>(addr)); }
+forceinline u64 read_be64(const void* addr) { return __builtin_bswap64(read_le<u64>(addr)); }
+
+/* Index encoding */
+
+// the offset of the square from the A1-H8 diagonal, negative below it
+forceinline i32 off_diagonal(Sq sq) { return (i32)RANK(sq) - (i32)FILE(sq); }
+
+/// Pre-calculated tables used to encode a position into the index of a table.
+struct PrecalcEncoding {
+    i32 mapPawns[64];          // squares A2-H7 to 0..47, the leading pawn has the highest value
+    i32 mapB1H1H7[64];         // squares below the A1-H8 diagonal to 0..27
+    i32 mapA1D1D4[64];         // squares in the A1-D1-D4 triangle to 0..9, the diagonal last
+    i32 mapKK[10][64];         // the 462 legal king pairs with the first king in the triangle
+    i32 binomial[6][64];       // [k][n] ways to choose k out of n elements
+    i32 leadPawnIdx[6][64];    // [lead pawn count][square]
+    i32 leadPawnsSize[6][4];   // [lead pawn count][file A-D]
+
+    PrecalcEncoding();
+};
+
+PrecalcEncoding::PrecalcEncoding() : mapPawns(), mapB1H1H7(), mapA1D1D4(), mapKK(), binomial(), leadPawnIdx(), leadPawnsSize() {
+    i32 code = 0;
+    for (Sq sq = 0; sq < 64; sq++) {
+        if (off_diagonal(sq) < 0) {
+            mapB1H1H7[sq] = code++;
+        }
+    }
+
+    // the squares on the diagonal are encoded last
+    std::vector<Sq> diagonal;
+    code = 0;
+    for (Sq sq = 0; sq <= INDEX(fD, 3); sq++) {
+        if (off_diagonal(sq) < 0 && FILE(sq) <= fD) {
+            mapA1D1D4[sq] = code++;
+        } else if (off_diagonal(sq) == 0 && FILE(sq) <= fD) {
+            diagonal.push_back(sq);
+        }
+    }
+
+    for (Sq sq : diagonal) {
+        mapA1D1D4[sq] = code++;
+    }
+
+    // if the first king is on the diagonal the second may not be above it,
+    // pairs with both kings on the diagonal are encoded last
+    std::vector<std::pair<i32, Sq>> bothOnDiagonal;
+    code = 0;
+    for (i32 idx = 0; idx < 10; idx++) {
+        for (Sq s1 = 0; s1 <= INDEX(fD, 3); s1++) {
+            if (mapA1D1D4[s1] != idx || (idx == 0 && s1 != INDEX(fB, 0))) {
+                continue;
+            }
+
+            for (Sq s2 = 0; s2 < 64; s2++) {
+                if ((lookup::kingMovementBBs.values[s1] | (1ULL << s1)) & (1ULL << s2)) {
+                    continue;
+                }
+
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) > 0) {
+                    continue;
+                }
+
+                if (off_diagonal(s1) == 0 && off_diagonal(s2) == 0) {
+                    bothOnDiagonal.emplace_back(idx, s2);
+                } else {
+                    mapKK[idx][s2] = code++;
+                }
+            }
+        }
+    }
+
+    for (auto& [idx, sq] : bothOnDiagonal) {
+        mapKK[idx][sq] = code++;
+    }
+
+    binomial[0][0] = 1;
+    for (i32 n = 1; n < 64; n++) {
+        for (i32 k = 0; k < 6 && k <= n; k++) {
+            binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+        }
+    }
+
+    // any other pawn can not be closer to the edge or lower than the leading
+    // one, so the available squares shrink by 2 with every rank due to mirroring
+    i32 availableSquares = 47;
+    for (i32 leadPawnsCount = 1; leadPawnsCount <= 5; leadPawnsCount++) {
+        for (u8 file = fA; file <= fD; file++) {
+            i32 idx = 0;
+            for (u8 rank = 1; rank <= 6; rank++) {
+                const Sq sq = INDEX(file, rank);
+                if (leadPawnsCount == 1) {
+                    mapPawns[sq] = availableSquares--;
+                    mapPawns[sq ^ 7] = availableSquares--;
+                }
+
+                leadPawnIdx[leadPawnsCount][sq] = idx;
+                idx += binomial[leadPawnsCount - 1][mapPawns[sq]];
+            }
+
+            leadPawnsSize[leadPawnsCount][file] = idx;
+        }
+    }
+}
+
+static const PrecalcEncoding encoding { };
+
+/* Tables */
+
+/// Points into the block lengths, stored little endian.
+struct SparseEntry {
+    u8 block[4];  // the block number
+    u8 offset[2]; // the offset within the block
+};
+
+static_assert(sizeof(SparseEntry) == 6);
+
+/// A Huffman symbol.
+typedef u16 Sym;
+
+/// The pair of symbols a symbol expands to, 12 bits each. If the symbol
+/// is a leaf the left symbol is the stored value.
+struct SymPair {
+    u8 lr[3];
+
+    forceinline Sym left() const { return ((lr[1] & 0xF) << 8) | lr[0]; }
+    forceinline Sym right() const { return (lr[2] << 4) | (lr[1] >> 4); }
+};
+
+static_assert(sizeof(SymPair) == 3);
+
+/// The decoding information of one sub-table, there is one per side to move
+/// and for tables with pawns one per file of the leading pawn.
+struct PairsData {
+    u8 flags;                    // see TableFlag
+    u8 maxSymLen;                // the maximum length in bits of the Huffman symbols
+    u8 minSymLen;                // the minimum length in bits of the Huffman symbols, or the single value
+    u32 numBlocks;
+    u64 sizeofBlock;             // the block size in bytes
+    u64 span;                    // about every span values there is a sparse index entry
+    const Sym* lowestSym;        // lowestSym[l] is the symbol of length l with the lowest value
+    const SymPair* btree;        // the symbols a symbol expands to
+    const u16* blockLength;      // the amount of values minus one per block
+    u32 blockLengthSize;
+    const SparseEntry* sparseIndex;
+    u64 sparseIndexSize;
+    const u8* data;              // the compressed blocks
+    std::vector<u64> base64;     // base64[l - minSymLen] is the lowest symbol of length l padded to 64 bits
+    std::vector<u8> symlen;      // the amount of values minus one a symbol expands to
+    u8 pieces[TB_MAX_PIECES];    // the pieces in encoding order, defining the groups
+    u64 groupIdx[TB_MAX_PIECES + 1]; // the start index of each group
+    i32 groupLen[TB_MAX_PIECES + 1]; // the pieces per group, zero terminated
+    u16 mapIdx[4];               // the offsets into the DTZ map per WDL result
+};
+
+/// A WDL or DTZ table, the indexing information is known from the file name
+/// on init while the PairsData is only read when the file is first mapped.
+template<TableType type>
+struct Table {
+    static constexpr int sides = type == TB_WDL ? 2 : 1;
+
+    std::atomic_bool ready = false;
+    MappedFile file;
+    const u8* map = nullptr; // the DTZ value map
+
+    std::string name; // e.g. KRPvKR
+    PositionHash key;  // the material key with the stronger side as white
+    PositionHash key2; // the material key with the colors swapped
+    u8 pieceCount;
+    bool hasPawns;
+    bool hasUniquePieces;
+    u8 pawnCount[2]; // [leading color, other color]
+
+    PairsData items[sides][4]; // [side to move][file of the leading pawn]
+
+    forceinline PairsData* get(int stm, int file) { return &items[stm % sides][hasPawns ? file : 0]; }
+};
+
+struct TableEntry {
+    Table<TB_WDL> wdl;
+    Table<TB_DTZ> dtz;
+};
+
+static std::deque<TableEntry> tables;
+static std::unordered_map<PositionHash, TableEntry*> tablesByKey;
+static std::vector<std::string> searchPaths;
+
+u8 largestTable = 0;
+
+// the piece code used by the tables: 1 - 6 for white pawn to king, 9 - 14 for black
+forceinline u8 to_tb_piece(Piece p) {
+    return (TYPE_OF_PIECE(p) + 1) | (IS_WHITE_PIECE(p) ? 0 : 8);
+}
+
+/* Decompression */
+
+// The values are compressed with recursive pairing, replacing the most frequent adjacent
+// pair of symbols by a new symbol, followed by canonical Huffman coding of the symbols.
+// The compressed data is split into blocks of sizeofBlock bytes with each block holding
+// a variable amount of values, the sparse index points to the block of every span-th value.
+static i32 decompress_pairs(PairsData* d, u64 idx) {
+    if (d->flags & TB_FLAG_SINGLE_VALUE) {
+        return d->minSymLen;
+    }
+
+    // find the sparse index entry closest to the value, it points to the value
+    // with the index k * span + span / 2
+    const u32 k = (u32)(idx / d->span);
+    u32 block = read_le<u32>(&d->sparseIndex[k].block);
+    i32 offset = read_le<u16>(&d->sparseIndex[k].offset);
+    offset += (i32)(idx % d->span) - (i32)(d->span / 2);
+
+    // walk the blocks until the offset is within the block
+    while (offset < 0) {
+        offset += d->blockLength[--block] + 1;
+    }
+
+    while (offset > d->blockLength[block]) {
+        offset -= d->blockLength[block++] + 1;
+    }
+
+    const u8* ptr = d->data + (u64)block * d->sizeofBlock;
+
+    // the block starts with a symbol, read 64 bits at a time and skip
+    // symbols until the one expanding to the value at the offset is found
+    u64 buf64 = read_be64(ptr);
+    ptr += 8;
+    i32 buf64Size = 64;
+    Sym sym;
+
+    while (true) {
+        // the symbol length minus minSymLen, longer symbols have lower values
+        i32 len = 0;
+        while (buf64 < d->base64[len]) {
+            len++;
+        }
+
+        sym = (Sym)((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym += read_le<Sym>(&d->lowestSym[len]);
+
+        if (offset < d->symlen[sym] + 1) {
+            break;
+        }
+
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        // refill the buffer
+        if (buf64Size <= 32) {
+            buf64Size += 32;
+            buf64 |= (u64)read_be32(ptr) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    // expand the symbol into its pairs until reaching the leaf holding the value
+    while (d->symlen[sym]) {
+        const Sym left = d->btree[sym].left();
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = d->btree[sym].right();
+        }
+    }
+
+    return d->btree[sym].left();
+}
+
+// Reconstruct the DTZ value from the stored one, the values are remapped
+// per WDL result by frequency and may be stored in moves instead of plies.
+static i32 map_dtz_score(Table<TB_DTZ>* entry, int file, i32 value, WDLScore wdl) {
+    constexpr i32 wdlMap[] = { 1, 3, 0, 2, 0 };
+
+    PairsData* d = entry->get(0, file);
+    const u8 flags = d->flags;
+
+    if (flags & TB_FLAG_MAPPED) {
+        const u16 idx = d->mapIdx[wdlMap[wdl + 2]] + value;
+        value = (flags & TB_FLAG_WIDE) ? read_le<u16>(entry->map + 2 * idx) : entry->map[idx];
+    }
+
+    if ((wdl == WDL_WIN && !(flags & TB_FLAG_WIN_PLIES)) ||
+        (wdl == WDL_LOSS && !(flags & TB_FLAG_LOSS_PLIES)) ||
+        wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS) {
+        value *= 2;
+    }
+
+    return value + 1;
+}
+
+/* Probing a single table */
+
+// Encode the position into the index of the table and decompress the value. The table stores
+// positions with the stronger side as white and the leading piece normalized by symmetry into
+// the A1-D1-D4 triangle, or with pawns onto the files A to D. Each group of identical pieces
+// is encoded as a combination: idx = binomial[1][s1] + binomial[2][s2] + ... + binomial[k][sk].
+template<TableType type>
+static i32 do_probe_table(Board* board, Table<type>* entry, WDLScore wdl, ProbeState* result) {
+    Sq squares[TB_MAX_PIECES];
+    u8 pieces[TB_MAX_PIECES];
+    u64 idx;
+    i32 next = 0, size = 0, leadPawnsCount = 0;
+    Bitboard bb, leadPawns = 0;
+    int tbFile = 0;
+
+    auto pawns_comp = [](Sq a, Sq b) { return encoding.mapPawns[a] < encoding.mapPawns[b]; };
+
+    // tables are stored with the stronger side as white, and tables with equal material
+    // only for white to move, otherwise flip the colors and squares vertically
+    const bool symmetricBlackToMove = entry->key == entry->key2 && board->turn == BLACK;
+    const bool blackStronger = board->material_key() != entry->key;
+    const bool flip = symmetricBlackToMove || blackStronger;
+    const u8 flipColor = flip * 8;
+    const u8 flipSquares = flip * 56;
+    const int stm = flip ^ (board->turn == BLACK);
+
+    // tables with pawns are split by the file of the leading pawn, the one
+    // closest to the edge and among those on the same file the lowest one
+    if (entry->hasPawns) {
+        const u8 pc = entry->get(0, 0)->pieces[0] ^ flipColor;
+        leadPawns = bb = board->pieces((Color)!(pc & 8), PAWN);
+        do {
+            squares[size++] = _pop_lsb(bb) ^ flipSquares;
+        } while (bb);
+
+        leadPawnsCount = size;
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCount, pawns_comp));
+        tbFile = MIN(FILE(squares[0]), 7 - FILE(squares[0]));
+    }
+
+    // DTZ tables only store one side to move
+    if constexpr (type == TB_DTZ) {
+        const u8 flags = entry->get(stm, tbFile)->flags;
+        if ((flags & TB_FLAG_STM) != stm && !(entry->key == entry->key2 && !entry->hasPawns)) {
+            *result = PROBE_CHANGE_STM;
+            return 0;
+        }
+    }
+
+    bb = board->all_pieces() ^ leadPawns;
+    do {
+        const Sq sq = _pop_lsb(bb);
+        squares[size] = sq ^ flipSquares;
+        pieces[size++] = to_tb_piece(board->piece_on(sq)) ^ flipColor;
+    } while (bb);
+
+    PairsData* d = entry->get(stm, tbFile);
+
+    // order the pieces like the table does
+    for (i32 i = leadPawnsCount; i < size - 1; i++) {
+        for (i32 j = i + 1; j < size; j++) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // mirror the leading piece onto the files A to D
+    if (FILE(squares[0]) > fD) {
+        for (i32 i = 0; i < size; i++) {
+            squares[i] ^= 7;
+        }
+    }
+
+    if (entry->hasPawns) {
+        idx = encoding.leadPawnIdx[leadPawnsCount][squares[0]];
+
+        std::stable_sort(squares + 1, squares + leadPawnsCount, pawns_comp);
+        for (i32 i = 1; i < leadPawnsCount; i++) {
+            idx += encoding.binomial[i][encoding.mapPawns[squares[i]]];
+        }
+    } else {
+        // mirror the leading piece onto the ranks 1 to 4
+        if (RANK(squares[0]) > 3) {
+            for (i32 i = 0; i < size; i++) {
+                squares[i] ^= 56;
+            }
+        }
+
+        // mirror the first piece of the leading group which is not
+        // on the A1-H8 diagonal to below the diagonal
+        for (i32 i = 0; i < d->groupLen[0]; i++) {
+            if (!off_diagonal(squares[i])) {
+                continue;
+            }
+
+            if (off_diagonal(squares[i]) > 0) {
+                for (i32 j = i; j < size; j++) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+
+            break;
+        }
+
+        // with at least three unique pieces (including the kings) the leading group is
+        // those three pieces, the first in the triangle and the others on the remaining
+        // squares, otherwise it is the two kings encoded through mapKK
+        if (entry->hasUniquePieces) {
+            const i32 adjust1 = squares[1] > squares[0];
+            const i32 adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+            if (off_diagonal(squares[0])) {
+                idx = (encoding.mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[1])) {
+                idx = (6 * 63 + RANK(squares[0]) * 28 + encoding.mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (off_diagonal(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + RANK(squares[0]) * 7 * 28 + (RANK(squares[1]) - adjust1) * 28 +
+                      encoding.mapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + RANK(squares[0]) * 7 * 6 + (RANK(squares[1]) - adjust1) * 6 +
+                      (RANK(squares[2]) - adjust2);
+            }
+        } else {
+            idx = encoding.mapKK[encoding.mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // encode the remaining groups, each square is mapped down
+    // by the amount of squares taken by the previous groups
+    idx *= d->groupIdx[0];
+    Sq* groupSq = squares + d->groupLen[0];
+    bool remainingPawns = entry->hasPawns && entry->pawnCount[1];
+
+    while (d->groupLen[++next]) {
+        std::stable_sort(groupSq, groupSq + d->groupLen[next]);
+
+        u64 n = 0;
+        for (i32 i = 0; i < d->groupLen[next]; i++) {
+            const i32 adjust = std::count_if(squares, groupSq, [&](Sq sq) { return groupSq[i] > sq; });
+            n += encoding.binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    const i32 value = decompress_pairs(d, idx);
+    if constexpr (type == TB_WDL) {
+        return value - 2;
+    } else {
+        return map_dtz_score(entry, tbFile, value, wdl);
+    }
+}
+
+/* Reading the table layout */
+
+// Group the pieces encoded together, a group holds pieces of the same type and color
+// except for the leading group which without pawns holds the first three pieces if
+// there are unique pieces and the two kings otherwise. The order of the groups in
+// the index is a per table parameter.
+template<TableType type>
+static void set_groups(Table<type>* e, PairsData* d, const i32* order, int file) {
+    i32 n = 0;
+    i32 firstLen = e->hasPawns ? 0 : e->hasUniquePieces ? 3 : 2;
+    d->groupLen[n] = 1;
+
+    for (i32 i = 1; i < e->pieceCount; i++) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->groupLen[n]++;
+        } else {
+            d->groupLen[++n] = 1;
+        }
+    }
+
+    d->groupLen[++n] = 0;
+
+    const bool pp = e->hasPawns && e->pawnCount[1];
+    i32 nextGroup = pp ? 2 : 1;
+    i32 freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    u64 idx = 1;
+
+    for (i32 k = 0; nextGroup < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            // leading pawns or pieces
+            d->groupIdx[0] = idx;
+            idx *= e->hasPawns ? encoding.leadPawnsSize[d->groupLen[0]][file] : e->hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            // remaining pawns
+            d->groupIdx[1] = idx;
+            idx *= encoding.binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            // remaining pieces
+            d->groupIdx[nextGroup] = idx;
+            idx *= encoding.binomial[d->groupLen[nextGroup]][freeSquares];
+            freeSquares -= d->groupLen[nextGroup++];
+        }
+    }
+
+    d->groupIdx[n] = idx;
+}
+
+// compute the amount of values the symbol expands to minus one
+static u8 set_symlen(PairsData* d, Sym s, std::vector<bool>& visited) {
+    visited[s] = true;
+
+    const Sym sr = d->btree[s].right();
+    if (sr == 0xFFF) {
+        return 0;
+    }
+
+    const Sym sl = d->btree[s].left();
+    if (!visited[sl]) d->symlen[sl] = set_symlen(d, sl, visited);
+    if (!visited[sr]) d->symlen[sr] = set_symlen(d, sr, visited);
+
+    return d->symlen[sl] + d->symlen[sr] + 1;
+}
+
+// read the Huffman code and the symbol tree, returns the data after it
+static const u8* set_sizes(PairsData* d, const u8* data) {
+    d->flags = *data++;
+
+    if (d->flags & TB_FLAG_SINGLE_VALUE) {
+        d->numBlocks = 0;
+        d->span = 0;
+        d->blockLengthSize = 0;
+        d->sparseIndexSize = 0;
+        d->minSymLen = *data++; // the single value
+        return data;
+    }
+
+    // the last group index is the size of the table
+    const u64 tbSize = d->groupIdx[std::find(d->groupLen, d->groupLen + TB_MAX_PIECES, 0) - d->groupLen];
+
+    d->sizeofBlock = 1ULL << *data++;
+    d->span = 1ULL << *data++;
+    d->sparseIndexSize = (tbSize + d->span - 1) / d->span;
+    const u8 padding = *data++;
+    d->numBlocks = read_le<u32>(data);
+    data += sizeof(u32);
+    d->blockLengthSize = d->numBlocks + padding; // padded so the sparse index never points out of range
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = (const Sym*)data;
+    d->base64.resize(d->maxSymLen - d->minSymLen + 1);
+
+    // in the canonical code longer symbols have lower values, compute the
+    // lowest value per symbol length left aligned to 64 bits
+    for (i32 i = (i32)d->base64.size() - 2; i >= 0; i--) {
+        d->base64[i] = (d->base64[i + 1] + read_le<Sym>(&d->lowestSym[i]) - read_le<Sym>(&d->lowestSym[i + 1])) / 2;
+    }
+
+    for (u64 i = 0; i < d->base64.size(); i++) {
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    }
+
+    data += d->base64.size() * sizeof(Sym);
+    d->symlen.resize(read_le<u16>(data));
+    data += sizeof(u16);
+    d->btree = (const SymPair*)data;
+
+    std::vector<bool> visited(d->symlen.size());
+    for (u64 sym = 0; sym < d->symlen.size(); sym++) {
+        if (!visited[sym]) {
+            d->symlen[sym] = set_symlen(d, (Sym)sym, visited);
+        }
+    }
+
+    return data + d->symlen.size() * sizeof(SymPair) + (d->symlen.size() & 1);
+}
+
+// read the maps from stored to real DTZ values, one per WDL result
+static const u8* set_dtz_map(Table<TB_DTZ>* e, const u8* data, int maxFile) {
+    e->map = data;
+
+    for (int file = 0; file <= maxFile; file++) {
+        PairsData* d = e->get(0, file);
+        if (!(d->flags & TB_FLAG_MAPPED)) {
+            continue;
+        }
+
+        if (d->flags & TB_FLAG_WIDE) {
+            data += (uintptr_t)data & 1; // word alignment
+            for (int i = 0; i < 4; i++) {
+                d->mapIdx[i] = (u16)((data - e->map) / 2 + 1);
+                data += 2 * read_le<u16>(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; i++) {
+                d->mapIdx[i] = (u16)(data - e->map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+
+    return data + ((uintptr_t)data & 1);
+}
+
+// populate the PairsData of the just mapped table, the data starts after the magic
+template<TableType type>
+static void read_table(Table<type>* e, const u8* data) {
+    data++; // flags, split and has pawns
+
+    const int sides = type == TB_WDL && e->key != e->key2 ? 2 : 1;
+    const int maxFile = e->hasPawns ? fD : fA;
+    const bool pp = e->hasPawns && e->pawnCount[1];
+
+    for (int file = 0; file <= maxFile; file++) {
+        for (int i = 0; i < sides; i++) {
+            *e->get(i, file) = PairsData();
+        }
+
+        const i32 order[2][2] = { { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
+                                  { *data >> 4, pp ? *(data + 1) >> 4 : 0xF } };
+        data += 1 + pp;
+
+        for (i32 k = 0; k < e->pieceCount; k++, data++) {
+            for (int i = 0; i < sides; i++) {
+                e->get(i, file)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+            }
+        }
+
+        for (int i = 0; i < sides; i++) {
+            set_groups(e, e->get(i, file), order[i], file);
+        }
+    }
+
+    data += (uintptr_t)data & 1;
+
+    for (int file = 0; file <= maxFile; file++) {
+        for (int i = 0; i < sides; i++) {
+            data = set_sizes(e->get(i, file), data);
+        }
+    }
+
+    if constexpr (type == TB_DTZ) {
+        data = set_dtz_map(e, data, maxFile);
+    }
+
+    for (int file = 0; file <= maxFile; file++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = e->get(i, file);
+            d->sparseIndex = (const SparseEntry*)data;
+            data += d->sparseIndexSize * sizeof(SparseEntry);
+        }
+    }
+
+    for (int file = 0; file <= maxFile; file++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = e->get(i, file);
+            d->blockLength = (const u16*)data;
+            data += d->blockLengthSize * sizeof(u16);
+        }
+    }
+
+    for (int file = 0; file <= maxFile; file++) {
+        for (int i = 0; i < sides; i++) {
+            data = (const u8*)(((uintptr_t)data + 0x3F) & ~(uintptr_t)0x3F); // 64 byte alignment
+            PairsData* d = e->get(i, file);
+            d->data = data;
+            data += d->numBlocks * d->sizeofBlock;
+        }
+    }
+}
+
+// Map the file of the table on its first access, returns whether the table is available.
+// Safe to call concurrently.
+template<TableType type>
+static bool map_table(Table<type>* e) {
+    static std::mutex mutex;
+
+    if (e->ready.load(std::memory_order_acquire)) {
+        return e->file.mapped();
+    }
+
+    std::scoped_lock lock(mutex);
+    if (e->ready.load(std::memory_order_relaxed)) {
+        return e->file.mapped();
+    }
+
+    const std::string fileName = e->name + (type == TB_WDL ? ".rtbw" : ".rtbz");
+    for (const std::string& dir : searchPaths) {
+        if (e->file.map((std::filesystem::path(dir) / fileName).string().c_str())) {
+            break;
+        }
+    }
+
+    // the files consist of 64 byte aligned blocks after a 16 byte header
+    if (e->file.mapped() && (e->file.size % 64 != 16 || memcmp(e->file.data, type == TB_WDL ? wdlMagic : dtzMagic, 4))) {
+        log<WARN>(P, "Corrupted tablebase file %s", fileName.c_str());
+        e->file.unmap();
+    }
+
+    if (e->file.mapped()) {
+        read_table(e, e->file.data + 4);
+    }
+
+    e->ready.store(true, std::memory_order_release);
+    return e->file.mapped();
+}
+
+template<TableType type>
+static i32 probe_table(Board* board, ProbeState* result, WDLScore wdl = WDL_DRAW) {
+    // KvK
+    if (_popcount64(board->all_pieces()) == 2) {
+        return WDL_DRAW;
+    }
+
+    auto it = tablesByKey.find(board->material_key());
+    if (it == tablesByKey.end()) {
+        *result = PROBE_FAIL;
+        return 0;
+    }
+
+    Table<type>* entry;
+    if constexpr (type == TB_WDL) entry = &it->second->wdl;
+    else                          entry = &it->second->dtz;
+
+    if (!map_table(entry)) {
+        *result = PROBE_FAIL;
+        return 0;
+    }
+
+    return do_probe_table(board, entry, wdl, result);
+}
+
+/* Probing with move resolution */
+
+template<Color turn>
+static u16 gen_legal_moves(Board* board, Move* out) {
+    MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
+    gen_all_moves<decltype(moveList), movegenAllPL, turn>(board, &moveList);
+
+    u16 count = 0;
+    for (u16 i = 0; i < moveList.count; i++) {
+        const Move move = moveList.get_move(i);
+        if (move.null()) continue;
+
+        ExtMove<true> extMove(move);
+        board->make_move_unchecked<turn, true>(&extMove);
+        if (!board->is_in_check<turn>()) {
+            out[count++] = move;
+        }
+
+        board->unmake_move_unchecked<turn, true>(&extMove);
+    }
+
+    return count;
+}
+
+forceinline bool is_capture(Board* board, Move move) {
+    return move.is_capture(board) || move.is_en_passant();
+}
+
+forceinline bool is_zeroing(Board* board, Move move) {
+    return is_capture(board, move) || TYPE_OF_PIECE(move.moved_piece(board)) == PAWN;
+}
+
+// the DTZ of the move before a zeroing move reaching a position with the given result
+static i32 dtz_before_zeroing(WDLScore wdl) {
+    return wdl == WDL_WIN          ?  1   :
+           wdl == WDL_CURSED_WIN   ?  101 :
+           wdl == WDL_BLESSED_LOSS ? -101 :
+           wdl == WDL_LOSS         ? -1   : 0;
+}
+
+forceinline i32 sign_of(i32 v) { return (0 < v) - (v < 0); }
+
+// The tables store "don't care" values for positions where the side to move has a winning
+// capture, and may store a loss for drawn positions with a drawing capture, so the captures
+// (and for DTZ all zeroing moves) have to be resolved and the best result taken.
+template<bool checkZeroingMoves, Color turn>
+static WDLScore search(Board* board, ProbeState* result) {
+    Move moves[MAX_MOVES];
+    const u16 totalCount = gen_legal_moves<turn>(board, moves);
+    u16 moveCount = 0;
+
+    WDLScore value, bestValue = WDL_LOSS;
+    for (u16 i = 0; i < totalCount; i++) {
+        const Move move = moves[i];
+        if (!is_capture(board, move) && (!checkZeroingMoves || TYPE_OF_PIECE(move.moved_piece(board)) != PAWN)) {
+            continue;
+        }
+
+        moveCount++;
+
+        ExtMove<true> extMove(move);
+        board->make_move_unchecked<turn, true>(&extMove);
+        value = (WDLScore)-search<false, !turn>(board, result);
+        board->unmake_move_unchecked<turn, true>(&extMove);
+
+        if (*result == PROBE_FAIL) {
+            return WDL_DRAW;
+        }
+
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= WDL_WIN) {
+                *result = PROBE_ZEROING_BEST;
+                return value;
+            }
+        }
+    }
+
+    // if all legal moves were searched the stored value may be wrong, the
+    // tables for example do not know about en passant rights
+    const bool noMoreMoves = moveCount && moveCount == totalCount;
+    if (noMoreMoves) {
+        value = bestValue;
+    } else {
+        value = (WDLScore)probe_table<TB_WDL>(board, result);
+        if (*result == PROBE_FAIL) {
+            return WDL_DRAW;
+        }
+    }
+
+    if (bestValue >= value) {
+        *result = bestValue > WDL_DRAW || noMoreMoves ? PROBE_ZEROING_BEST : PROBE_OK;
+        return bestValue;
+    }
+
+    *result = PROBE_OK;
+    return value;
+}
+
+template<Color turn>
+static i32 probe_dtz(Board* board, ProbeState* result) {
+    *result = PROBE_OK;
+    const WDLScore wdl = search<true, turn>(board, result);
+
+    // draws are not stored
+    if (*result == PROBE_FAIL || wdl == WDL_DRAW) {
+        return 0;
+    }
+
+    // the stored value is a "don't care" if the best move zeroes
+    if (*result == PROBE_ZEROING_BEST) {
+        return dtz_before_zeroing(wdl);
+    }
+
+    i32 dtz = probe_table<TB_DTZ>(board, result, wdl);
+    if (*result == PROBE_FAIL) {
+        return 0;
+    }
+
+    if (*result != PROBE_CHANGE_STM) {
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * sign_of(wdl);
+    }
+
+    // the table stores the other side to move, find the move with the
+    // best DTZ preserving the result with a one ply search
+    Move moves[MAX_MOVES];
+    const u16 count = gen_legal_moves<turn>(board, moves);
+
+    i32 minDTZ = 0xFFFF;
+    for (u16 i = 0; i < count; i++) {
+        const Move move = moves[i];
+        const bool zeroing = is_zeroing(board, move);
+
+        ExtMove<true> extMove(move);
+        board->make_move_unchecked<turn, true>(&extMove);
+
+        // for zeroing moves the DTZ before the move is wanted, the search
+        // after the move gives the result sign
+        dtz = zeroing ? -dtz_before_zeroing(search<false, !turn>(board, result))
+                      : -probe_dtz<!turn>(board, result);
+
+        // a mating move
+        if (dtz == 1 && board->is_in_check<!turn>()) {
+            Move replies[MAX_MOVES];
+            if (gen_legal_moves<!turn>(board, replies) == 0) {
+                minDTZ = 1;
+            }
+        }
+
+        if (!zeroing) {
+            dtz += sign_of(dtz);
+        }
+
+        if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl)) {
+            minDTZ = dtz;
+        }
+
+        board->unmake_move_unchecked<turn, true>(&extMove);
+
+        if (*result == PROBE_FAIL) {
+            return 0;
+        }
+    }
+
+    // no legal moves, the position is mate
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+template<Color turn>
+static bool filter_root_moves(Board* board, Move* moves, u16* count) {
+    ProbeState result = PROBE_OK;
+    const i32 rule50 = board->volatile_state()->rule50Ply;
+
+    // the rank of each move, better moves rank higher, certain wins rank equally
+    // and losses rank equally unless a 50 move draw is in sight
+    i32 ranks[MAX_MOVES];
+    i32 bestRank = -TB_MAX_DTZ - 1;
+
+    for (u16 i = 0; i < *count; i++) {
+        const Move move = moves[i];
+
+        ExtMove<true> extMove(move);
+        board->make_move_unchecked<turn, true>(&extMove);
+
+        i32 dtz;
+        if (board->volatile_state()->rule50Ply == 0) {
+            // one of -101, -1, 0, 1, 101 for zeroing moves
+            dtz = dtz_before_zeroing((WDLScore)-probe_wdl(board, &result));
+        } else {
+            dtz = -probe_dtz<!turn>(board, &result);
+            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+        }
+
+        // a mating move
+        if (dtz == 2 && board->is_in_check<!turn>()) {
+            Move replies[MAX_MOVES];
+            if (gen_legal_moves<!turn>(board, replies) == 0) {
+                dtz = 1;
+            }
+        }
+
+        board->unmake_move_unchecked<turn, true>(&extMove);
+
+        if (result == PROBE_FAIL) {
+            return false;
+        }
+
+        ranks[i] = dtz > 0 ? (dtz + rule50 <= 99 ? TB_MAX_DTZ : TB_MAX_DTZ - (dtz + rule50)) :
+                   dtz < 0 ? (-dtz * 2 + rule50 < 100 ? -TB_MAX_DTZ : -TB_MAX_DTZ + (-dtz + rule50)) :
+                   0;
+        bestRank = MAX(bestRank, ranks[i]);
+    }
+
+    u16 kept = 0;
+    for (u16 i = 0; i < *count; i++) {
+        if (ranks[i] == bestRank) {
+            moves[kept++] = moves[i];
+        }
+    }
+
+    *count = kept;
+    return true;
+}
+
+/* Public interface */
+
+// compute the material key of the given side of a table name like KRPvKR, the side given first as white
+static PositionHash material_key_of(const std::string& white, const std::string& black) {
+    PositionHash key = 0;
+    u8 counts[1 << 5] = { };
+    for (Color color : { WHITE, BLACK }) {
+        for (char c : color ? white : black) {
+            const Piece p = charToPieceType(c) | PIECE_COLOR_FOR(color);
+            key ^= materialHashes[MATERIAL_HASH_KEY(p, counts[p]++)];
+        }
+    }
+
+    return key;
+}
+
+// register the table with the given name, e.g. KRPvKR
+static void add_table(const std::string& name) {
+    const u64 v = name.find('v');
+    const std::string white = name.substr(0, v);
+    const std::string black = name.substr(v + 1);
+
+    TableEntry& entry = tables.emplace_back();
+    auto fill = [&](auto* e) {
+        e->name = name;
+        e->key = material_key_of(white, black);
+        e->key2 = material_key_of(black, white);
+        e->pieceCount = name.size() - 1;
+
+        const u8 whitePawns = std::count(white.begin(), white.end(), 'P');
+        const u8 blackPawns = std::count(black.begin(), black.end(), 'P');
+        e->hasPawns = whitePawns + blackPawns > 0;
+
+        e->hasUniquePieces = false;
+        for (const std::string* side : { &white, &black }) {
+            for (char c : std::string("PNBRQ")) {
+                if (std::count(side->begin(), side->end(), c) == 1) {
+                    e->hasUniquePieces = true;
+                }
+            }
+        }
+
+        // the leading color is the one with less pawns, which compresses better
+        const bool whiteLeads = blackPawns == 0 || (whitePawns > 0 && blackPawns >= whitePawns);
+        e->pawnCount[0] = whiteLeads ? whitePawns : blackPawns;
+        e->pawnCount[1] = whiteLeads ? blackPawns : whitePawns;
+    };
+
+    fill(&entry.wdl);
+    fill(&entry.dtz);
+
+    tablesByKey[entry.wdl.key] = &entry;
+    tablesByKey[entry.wdl.key2] = &entry;
+    largestTable = MAX(largestTable, entry.wdl.pieceCount);
+}
+
+// whether the file name is of a WDL table like KRPvKR.rtbw
+static bool is_wdl_table_name(const std::string& fileName, std::string* name) {
+    if (fileName.size() < 8 || !fileName.ends_with(".rtbw")) {
+        return false;
+    }
+
+    *name = fileName.substr(0, fileName.size() - 5);
+    const u64 v = name->find('v');
+    if (v == std::string::npos || name->size() - 1 > TB_MAX_PIECES || (*name)[0] != 'K' || v + 1 >= name->size() || (*name)[v + 1] != 'K') {
+        return false;
+    }
+
+    for (u64 i = 0; i < name->size(); i++) {
+        if (i != v && std::string("KQRBNP").find((*name)[i]) == std::string::npos) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+u32 init(const std::string& paths) {
+    for (TableEntry& entry : tables) {
+        entry.wdl.file.unmap();
+        entry.dtz.file.unmap();
+    }
+
+    tablesByKey.clear();
+    tables.clear();
+    searchPaths.clear();
+    largestTable = 0;
+
+    if (paths.empty() || paths == "<empty>") {
+        return 0;
+    }
+
+#ifdef _WIN32
+    constexpr char separator = ';';
+#else
+    constexpr char separator = ':';
+#endif
+
+    std::stringstream ss(paths);
+    std::string dir;
+    while (std::getline(ss, dir, separator)) {
+        if (!dir.empty()) {
+            searchPaths.push_back(dir);
+        }
+    }
+
+    // register every WDL table found, the DTZ table is looked for on its first probe
+    for (const std::string& dir : searchPaths) {
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(dir, error)) {
+            std::string name;
+            if (!file.is_regular_file() || !is_wdl_table_name(file.path().filename().string(), &name)) {
+                continue;
+            }
+
+            if (name.find('v') == 1 && name.size() == 3) {
+                continue; // KvK
+            }
+
+            auto it = tablesByKey.find(material_key_of(name.substr(0, name.find('v')), name.substr(name.find('v') + 1)));
+            if (it == tablesByKey.end()) {
+                add_table(name);
+            }
+        }
+    }
+
+    return tables.size();
+}
+
+WDLScore probe_wdl(Board* board, ProbeState* result) {
+    *result = PROBE_OK;
+    return board->turn ? search<false, WHITE>(board, result) : search<false, BLACK>(board, result);
+}
+
+i32 probe_dtz(Board* board, ProbeState* result) {
+    return board->turn ? probe_dtz<WHITE>(board, result) : probe_dtz<BLACK>(board, result);
+}
+
+bool filter_root_moves(Board* board, Move* moves, u16* count) {
+    if (*count == 0) {
+        return false;
+    }
+
+    return board->turn ? filter_root_moves<WHITE>(board, moves, count) : filter_root_moves<BLACK>(board, moves, count);
+}
+
+}
\ No newline at end of file
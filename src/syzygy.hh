@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+#include "types.hh"
+#include "platform.hh"
+#include "move.hh"
+
+/*
+    Syzygy endgame tablebase probing. The .rtbw (win/draw/loss) and .rtbz (distance to zeroing)
+    files are discovered in the configured directories on init and only memory mapped on their
+    first probe. The file format and the position indexing follow the reference prober.
+ */
+
+namespace tc { struct Board; }
+
+namespace tc::syzygy {
+
+#define TB_MAX_PIECES 7
+
+/// @brief The result of a WDL probe from the perspective of the side to move.
+enum WDLScore : i8 {
+    WDL_LOSS         = -2,
+    WDL_BLESSED_LOSS = -1, // loss, but a draw under the 50 move rule
+    WDL_DRAW         =  0,
+    WDL_CURSED_WIN   =  1, // win, but a draw under the 50 move rule
+    WDL_WIN          =  2,
+};
+
+/// @brief The outcome of a probe, anything but PROBE_FAIL means the returned value is valid.
+enum ProbeState : i8 {
+    PROBE_FAIL         =  0, // the table is missing or corrupted
+    PROBE_OK           =  1,
+    PROBE_CHANGE_STM   = -1, // the DTZ table only stores the other side to move
+    PROBE_ZEROING_BEST =  2, // the best move zeroes the 50 move counter
+};
+
+/// @brief The most pieces of any table found on init, 0 if probing is disabled.
+extern u8 largestTable;
+
+forceinline u8 max_pieces() { return largestTable; }
+
+/// @brief (Re)initialize the tablebases from the given directories, separated by ':' (';' on Windows).
+/// Unmaps all previously found tables, an empty path or "<empty>" disables probing.
+/// @return The amount of tables found.
+u32 init(const std::string& paths);
+
+/// @brief Probe the WDL tables for the given position, which must not have castling rights.
+WDLScore probe_wdl(Board* board, ProbeState* result);
+
+/// @brief Probe the DTZ tables for the given position, which must not have castling rights.
+/// @return The distance to the next zeroing move in plies, negative if the side to move is losing,
+/// 0 for a draw and beyond +-100 if the result is a draw under the 50 move rule. The value may
+/// be one ply too large when not on the edge of the 50 move rule.
+i32 probe_dtz(Board* board, ProbeState* result);
+
+/// @brief Rank the given legal root moves by DTZ and keep only the best ranked ones, so the move
+/// played preserves the best result achievable under the 50 move rule.
+/// @return Whether the root position was found in the tablebases, the moves are untouched if not.
+bool filter_root_moves(Board* board, Move* moves, u16* count);
+
+}
\ No newline at end of file
@@ -0,0 +1,1171 @@
+#include "tbgen.hh"
+#include "board.hh"
+#include "lookup.hh"
+#include "logging.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace tc::tbgen {
+
+u8 largestTable = 0;
+
+/* ------------- Material ------------- */
+
+static const i32 strengthPerType[] = { 1, 3, 3, 5, 9, 0 };
+
+static bool is_weaker_piece(Piece a, Piece b) {
+    return TYPE_OF_PIECE(a) < TYPE_OF_PIECE(b);
+}
+
+void Material::set(const Piece* list, u8 n) {
+    count = 0;
+    for (Color color : { WHITE, BLACK }) {
+        pieces[count++] = KING | PIECE_COLOR_FOR(color);
+        const u8 first = count;
+        for (u8 i = 0; i < n; i++) {
+            if (IS_WHITE_PIECE(list[i]) == color && TYPE_OF_PIECE(list[i]) != KING) {
+                pieces[count++] = list[i];
+            }
+        }
+
+        std::sort(pieces + first, pieces + count, [](Piece a, Piece b) { return is_weaker_piece(b, a); });
+        if (color == WHITE) {
+            whiteCount = count;
+        }
+    }
+}
+
+bool Material::parse(const std::string& str) {
+    const u64 split = str.find('v');
+    if (split == std::string::npos || split + 1 >= str.size() || str.size() - 1 > TCTB_MAX_PIECES) {
+        return false;
+    }
+
+    Piece list[TCTB_MAX_PIECES];
+    u8 n = 0;
+    for (u64 i = 0; i < str.size(); i++) {
+        if (i == split) {
+            continue;
+        }
+
+        const PieceType type = charToPieceType(str[i]);
+        if (type == NULL_PIECE_TYPE || (type == KING) != (i == 0 || i == split + 1)) {
+            return false;
+        }
+
+        list[n++] = type | PIECE_COLOR_FOR(i < split);
+    }
+
+    set(list, n);
+    return true;
+}
+
+bool Material::canonicalize() {
+    i32 strength[2] = { 0, 0 };
+    for (u8 i = 0; i < count; i++) {
+        strength[IS_WHITE_PIECE(pieces[i])] += strengthPerType[TYPE_OF_PIECE(pieces[i])];
+    }
+
+    const u8 blackCount = count - whiteCount;
+    const bool swap = strength[BLACK] > strength[WHITE] ||
+        (strength[BLACK] == strength[WHITE] && (blackCount > whiteCount ||
+        (blackCount == whiteCount && std::lexicographical_compare(pieces + 1, pieces + whiteCount, pieces + whiteCount + 1, pieces + count,
+                                                                  [](Piece a, Piece b) { return is_weaker_piece(a, b); }))));
+    if (!swap) {
+        return false;
+    }
+
+    Piece list[TCTB_MAX_PIECES];
+    for (u8 i = 0; i < count; i++) {
+        list[i] = pieces[i] ^ WHITE_PIECE;
+    }
+
+    set(list, count);
+    return true;
+}
+
+std::string Material::name() const {
+    std::string str;
+    for (u8 i = 0; i < count; i++) {
+        if (i == whiteCount) {
+            str += 'v';
+        }
+
+        str += (char)toupper(typeToCharLowercase[TYPE_OF_PIECE(pieces[i])]);
+    }
+
+    return str;
+}
+
+u64 Material::key() const {
+    u8 counts[32] = { 0 };
+    PositionHash key = 0;
+    for (u8 i = 0; i < count; i++) {
+        key ^= materialHashes[MATERIAL_HASH_KEY(pieces[i], counts[pieces[i]]++)];
+    }
+
+    return key;
+}
+
+bool Material::has_pawns() const {
+    for (u8 i = 0; i < count; i++) {
+        if (TYPE_OF_PIECE(pieces[i]) == PAWN) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* ------------- Indexing ------------- */
+
+// the pairs of king squares after normalizing by the board symmetries, for tables
+// without pawns the white king is in the a1-d1-d4 triangle and the black king on or
+// below the diagonal if the white king is on it, with pawns only the files are mirrored
+struct PrecalcKingPairs {
+    i16 index[2][64][64]; // [hasPawns][white king][black king], -1 if not a normalized pair
+    Sq squares[2][1806][2];
+    u16 count[2] = { 0, 0 };
+
+    PrecalcKingPairs() {
+        for (u8 hasPawns = 0; hasPawns < 2; hasPawns++) {
+            for (Sq wk = 0; wk < 64; wk++) {
+                for (Sq bk = 0; bk < 64; bk++) {
+                    index[hasPawns][wk][bk] = -1;
+
+                    const bool normalized = hasPawns ? FILE(wk) <= 3 :
+                        (FILE(wk) <= 3 && RANK(wk) <= FILE(wk) && (RANK(wk) != FILE(wk) || RANK(bk) <= FILE(bk)));
+                    // not through the lookup tables, which may not be initialized yet
+                    const bool adjacent = abs(FILE(wk) - FILE(bk)) <= 1 && abs(RANK(wk) - RANK(bk)) <= 1;
+                    if (!normalized || adjacent) {
+                        continue;
+                    }
+
+                    squares[hasPawns][count[hasPawns]][0] = wk;
+                    squares[hasPawns][count[hasPawns]][1] = bk;
+                    index[hasPawns][wk][bk] = count[hasPawns]++;
+                }
+            }
+        }
+    }
+};
+
+static const PrecalcKingPairs kingPairs;
+
+u64 Material::size() const {
+    u64 size = kingPairs.count[has_pawns()];
+    for (u8 i = 1; i < count; i++) {
+        if (i != whiteCount) {
+            size *= TYPE_OF_PIECE(pieces[i]) == PAWN ? 48 : 64;
+        }
+    }
+
+    return size;
+}
+
+forceinline static Sq transpose(Sq sq) {
+    return ((sq & 7) << 3) | (sq >> 3);
+}
+
+// whether the normalized squares have a mirrored twin in the index, which is the case
+// without pawns when both kings are on the a1-h8 diagonal
+forceinline static bool has_diagonal_twin(const Material& m, const Sq* sq) {
+    return RANK(sq[0]) == FILE(sq[0]) && RANK(sq[m.whiteCount]) == FILE(sq[m.whiteCount]);
+}
+
+// mirror the squares in place so the kings form a normalized pair
+forceinline static void normalize(const Material& m, bool hasPawns, Sq* sq) {
+    u8 flip = FILE(sq[0]) > 3 ? 7 : 0;
+    if (!hasPawns && RANK(sq[0]) > 3) {
+        flip ^= 56;
+    }
+
+    for (u8 i = 0; i < m.count; i++) {
+        sq[i] ^= flip;
+    }
+
+    if (!hasPawns && (RANK(sq[0]) > FILE(sq[0]) ||
+                      (RANK(sq[0]) == FILE(sq[0]) && RANK(sq[m.whiteCount]) > FILE(sq[m.whiteCount])))) {
+        for (u8 i = 0; i < m.count; i++) {
+            sq[i] = transpose(sq[i]);
+        }
+    }
+}
+
+// the index of the given squares in material order, which are normalized in place, or -1
+// for positions which are not indexed at all
+static i64 encode(const Material& m, bool hasPawns, Sq* sq) {
+    normalize(m, hasPawns, sq);
+
+    i64 idx = kingPairs.index[hasPawns][sq[0]][sq[m.whiteCount]];
+    if (idx < 0) {
+        return -1;
+    }
+
+    for (u8 i = 1; i < m.count; i++) {
+        if (i == m.whiteCount) {
+            continue;
+        }
+
+        if (TYPE_OF_PIECE(m.pieces[i]) == PAWN) {
+            if (RANK(sq[i]) == 0 || RANK(sq[i]) == 7) {
+                return -1;
+            }
+
+            idx = idx * 48 + (sq[i] - 8);
+        } else {
+            idx = idx * 64 + sq[i];
+        }
+    }
+
+    return idx;
+}
+
+static void decode(const Material& m, bool hasPawns, u64 idx, Sq* sq) {
+    for (u8 i = m.count - 1; i >= 1; i--) {
+        if (i == m.whiteCount) {
+            continue;
+        }
+
+        if (TYPE_OF_PIECE(m.pieces[i]) == PAWN) {
+            sq[i] = idx % 48 + 8;
+            idx /= 48;
+        } else {
+            sq[i] = idx % 64;
+            idx /= 64;
+        }
+    }
+
+    sq[0] = kingPairs.squares[hasPawns][idx][0];
+    sq[m.whiteCount] = kingPairs.squares[hasPawns][idx][1];
+}
+
+/* ------------- Positions ------------- */
+
+// the squares attacked by the given piece
+forceinline static Bitboard attacks_of(Piece p, Sq sq, Bitboard occupied) {
+    switch (TYPE_OF_PIECE(p)) {
+    case PAWN:   return lookup::pawnAttackBBs.values[IS_WHITE_PIECE(p)][sq];
+    case KNIGHT: return lookup::knightAttackBBs.values[sq];
+    case BISHOP: return lookup::magic::bishop_attack_bb(sq, occupied);
+    case ROOK:   return lookup::magic::rook_attack_bb(sq, occupied);
+    case QUEEN:  return lookup::magic::bishop_attack_bb(sq, occupied) | lookup::magic::rook_attack_bb(sq, occupied);
+    default:     return lookup::kingMovementBBs.values[sq];
+    }
+}
+
+// whether the target square is attacked by the given color, pieces on NULL_SQ are captured
+static bool is_attacked(const Material& m, const Sq* sq, Bitboard occupied, Sq target, Color by) {
+    for (u8 i = 0; i < m.count; i++) {
+        if (sq[i] != NULL_SQ && IS_WHITE_PIECE(m.pieces[i]) == by && (attacks_of(m.pieces[i], sq[i], occupied) & (1ULL << target))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+forceinline static Bitboard occupancy_of(const Material& m, const Sq* sq) {
+    Bitboard occupied = 0;
+    for (u8 i = 0; i < m.count; i++) {
+        occupied |= 1ULL << sq[i];
+    }
+
+    return occupied;
+}
+
+// whether no pieces overlap and the side not to move is not in check
+static bool is_valid(const Material& m, const Sq* sq, Color stm) {
+    const Bitboard occupied = occupancy_of(m, sq);
+    return _popcount64(occupied) == m.count && !is_attacked(m, sq, occupied, sq[stm ? m.whiteCount : 0], stm);
+}
+
+// call fn(after, captured, promoted, promotionType) for every legal move of the side to move with the
+// squares after the move, a captured piece is left on NULL_SQ. En passant is not generated
+template<typename F>
+static void for_each_move(const Material& m, const Sq* sq, Color stm, F&& fn) {
+    Bitboard occupied = 0;
+    Bitboard own = 0;
+    for (u8 i = 0; i < m.count; i++) {
+        occupied |= 1ULL << sq[i];
+        own |= (Bitboard)(IS_WHITE_PIECE(m.pieces[i]) == stm) << sq[i];
+    }
+
+    const Bitboard enemy = occupied & ~own;
+    const u8 king = stm ? 0 : m.whiteCount;
+
+    Sq after[TCTB_MAX_PIECES];
+    auto play = [&](u8 i, Sq to, PieceType promotionType) {
+        memcpy(after, sq, m.count);
+
+        i8 captured = -1;
+        if (enemy & (1ULL << to)) {
+            for (u8 j = 0; j < m.count; j++) {
+                if (sq[j] == to) captured = j;
+            }
+
+            after[captured] = NULL_SQ;
+        }
+
+        after[i] = to;
+        const Bitboard occupiedAfter = (occupied & ~(1ULL << sq[i])) | (1ULL << to);
+        if (is_attacked(m, after, occupiedAfter, after[king], !stm)) {
+            return;
+        }
+
+        fn(after, captured, promotionType == NULL_PIECE_TYPE ? -1 : (i8)i, promotionType);
+    };
+
+    for (u8 i = 0; i < m.count; i++) {
+        const Piece p = m.pieces[i];
+        if (IS_WHITE_PIECE(p) != stm) {
+            continue;
+        }
+
+        if (TYPE_OF_PIECE(p) == PAWN) {
+            const i8 dir = stm ? 8 : -8;
+            const Sq push = sq[i] + dir;
+            const bool promotes = RANK(push) == (stm ? 7 : 0);
+            auto pawn_to = [&](Sq to) {
+                if (!promotes) { play(i, to, NULL_PIECE_TYPE); return; }
+                for (u8 pt = QUEEN; pt >= KNIGHT; pt--) play(i, to, (PieceType)pt);
+            };
+
+            if (!(occupied & (1ULL << push))) {
+                pawn_to(push);
+                if (RANK(sq[i]) == (stm ? 1 : 6) && !(occupied & (1ULL << (push + dir)))) {
+                    play(i, push + dir, NULL_PIECE_TYPE);
+                }
+            }
+
+            Bitboard captures = lookup::pawnAttackBBs.values[stm][sq[i]] & enemy;
+            while (captures) {
+                pawn_to(_pop_lsb(captures));
+            }
+
+            continue;
+        }
+
+        Bitboard targets = attacks_of(p, sq[i], occupied) & ~own;
+        while (targets) {
+            play(i, _pop_lsb(targets), NULL_PIECE_TYPE);
+        }
+    }
+}
+
+// call fn(before) for every position the given side could have moved from into the given
+// position without capturing or promoting, the positions are not checked for legality
+template<typename F>
+static void for_each_unmove(const Material& m, const Sq* sq, Color mover, F&& fn) {
+    const Bitboard occupied = occupancy_of(m, sq);
+
+    Sq before[TCTB_MAX_PIECES];
+    memcpy(before, sq, m.count);
+    for (u8 i = 0; i < m.count; i++) {
+        const Piece p = m.pieces[i];
+        if (IS_WHITE_PIECE(p) != mover) {
+            continue;
+        }
+
+        Bitboard origins;
+        if (TYPE_OF_PIECE(p) == PAWN) {
+            origins = 0;
+            const i8 dir = mover ? -8 : 8;
+            const Sq from = sq[i] + dir;
+            if (RANK(from) != (mover ? 0 : 7) && !(occupied & (1ULL << from))) {
+                origins |= 1ULL << from;
+                if (RANK(from) == (mover ? 2 : 5) && !(occupied & (1ULL << (from + dir)))) {
+                    origins |= 1ULL << (from + dir);
+                }
+            }
+        } else {
+            origins = attacks_of(p, sq[i], occupied) & ~occupied;
+        }
+
+        while (origins) {
+            before[i] = _pop_lsb(origins);
+            fn(before);
+        }
+
+        before[i] = sq[i];
+    }
+}
+
+/* ------------- Generation ------------- */
+
+struct GenTable;
+
+// the table a position is in after a capture and/or promotion, with the slot of each piece
+// in the material order of that table
+struct Conversion {
+    GenTable* table = nullptr; // null for KvK, which is always drawn
+    bool swapped = false;      // whether the colors are swapped in the table
+    i8 slot[TCTB_MAX_PIECES];
+};
+
+// a table being generated or converted into, fully decompressed
+struct GenTable {
+    Material material;
+    bool hasPawns = false;
+    u64 size = 0;
+    std::vector<u8> values[2]; // indexed by side to move
+
+    // [captured piece + 1][promoted pawn + 1][promotion type - KNIGHT]
+    Conversion conversions[TCTB_MAX_PIECES + 1][TCTB_MAX_PIECES + 1][4];
+
+    forceinline i64 index_of(const Sq* sq) const {
+        Sq normalized[TCTB_MAX_PIECES];
+        memcpy(normalized, sq, material.count);
+        return encode(material, hasPawns, normalized);
+    }
+
+    forceinline Conversion& conversion(i8 captured, i8 promoted, PieceType promotionType) {
+        return conversions[captured + 1][promoted + 1][promoted >= 0 ? promotionType - KNIGHT : 0];
+    }
+};
+
+// the material after the given capture and/or promotion, in the original colors
+static Material converted_material(const Material& m, i8 captured, i8 promoted, PieceType promotionType) {
+    Piece list[TCTB_MAX_PIECES];
+    u8 n = 0;
+    for (u8 i = 0; i < m.count; i++) {
+        if (i == captured) continue;
+        list[n++] = i == promoted ? (promotionType | COLOR_OF_PIECE(m.pieces[i])) : m.pieces[i];
+    }
+
+    Material result;
+    result.set(list, n);
+    return result;
+}
+
+// call fn(captured, promoted, promotionType) for every capture and/or promotion possible in the material
+template<typename F>
+static void for_each_conversion(const Material& m, F&& fn) {
+    for (i8 captured = -1; captured < m.count; captured++) {
+        if (captured >= 0 && TYPE_OF_PIECE(m.pieces[captured]) == KING) {
+            continue;
+        }
+
+        fn(captured, (i8)-1, NULL_PIECE_TYPE);
+        for (i8 promoted = 0; promoted < m.count; promoted++) {
+            if (promoted == captured || TYPE_OF_PIECE(m.pieces[promoted]) != PAWN) {
+                continue;
+            }
+
+            for (u8 pt = KNIGHT; pt <= QUEEN; pt++) {
+                fn(captured, promoted, (PieceType)pt);
+            }
+        }
+    }
+}
+
+// the value for the side that made the move of the position after a capture and/or promotion
+static u8 conversion_value(GenTable* t, const Sq* sq, Color mover, i8 captured, i8 promoted, PieceType promotionType) {
+    const Conversion& c = t->conversion(captured, promoted, promotionType);
+    if (!c.table) {
+        return TB_VALUE_DRAW;
+    }
+
+    Sq converted[TCTB_MAX_PIECES];
+    for (u8 i = 0; i < t->material.count; i++) {
+        if (i != captured) converted[c.slot[i]] = c.swapped ? sq[i] ^ 56 : sq[i];
+    }
+
+    const i64 idx = encode(c.table->material, c.table->hasPawns, converted);
+    const u8 v = idx >= 0 ? c.table->values[!mover ^ c.swapped][idx] : TB_VALUE_DRAW;
+    return value_is_decided(v) && v < TB_VALUE_MAX ? v + 1 : TB_VALUE_DRAW;
+}
+
+// the ordering of values for the side to move, shorter wins and longer losses are better
+forceinline static i32 preference_of(u8 v) {
+    if (!value_is_decided(v)) return 0;
+    return value_is_win(v) ? 512 - v : -512 + v;
+}
+
+// the value of a position before any retrograde analysis: invalid positions, mates and
+// stalemates are final, wins by a conversion are tentative until a shorter win is found
+// and positions with only conversions are decided by them
+static u8 initial_value(GenTable* t, u64 idx, Color stm) {
+    const Material& m = t->material;
+    Sq sq[TCTB_MAX_PIECES];
+    decode(m, t->hasPawns, idx, sq);
+    if (!is_valid(m, sq, stm)) {
+        return TB_VALUE_INVALID;
+    }
+
+    bool anyMove = false;
+    bool anyQuiet = false;
+    u8 best = TB_VALUE_DRAW;
+    i32 bestPreference = INT32_MIN;
+    for_each_move(m, sq, stm, [&](const Sq* after, i8 captured, i8 promoted, PieceType promotionType) {
+        anyMove = true;
+        if (captured < 0 && promoted < 0) {
+            anyQuiet = true;
+            return;
+        }
+
+        const u8 v = conversion_value(t, after, stm, captured, promoted, promotionType);
+        if (preference_of(v) > bestPreference) {
+            best = v;
+            bestPreference = preference_of(v);
+        }
+    });
+
+    if (!anyMove) {
+        const Bitboard occupied = occupancy_of(m, sq);
+        return is_attacked(m, sq, occupied, sq[stm ? 0 : m.whiteCount], !stm) ? /* mated */ 1 : TB_VALUE_DRAW;
+    }
+
+    if (!anyQuiet || value_is_win(best)) {
+        return best;
+    }
+
+    return TB_VALUE_DRAW;
+}
+
+// the value of a position if every move loses within the plies decided so far, draw otherwise
+static u8 verify_loss(GenTable* t, const Sq* sq, Color stm, u32 n) {
+    u8 longest = TB_VALUE_DRAW;
+    bool lost = true;
+    for_each_move(t->material, sq, stm, [&](const Sq* after, i8 captured, i8 promoted, PieceType promotionType) {
+        if (!lost) {
+            return;
+        }
+
+        u8 v;
+        if (captured < 0 && promoted < 0) {
+            v = t->values[!stm][t->index_of(after)];
+            if (!value_is_win(v) || v > n) {
+                lost = false;
+                return;
+            }
+
+            v++;
+        } else {
+            v = conversion_value(t, after, stm, captured, promoted, promotionType);
+            if (!value_is_decided(v) || value_is_win(v)) {
+                lost = false;
+                return;
+            }
+        }
+
+        longest = MAX(longest, v);
+    });
+
+    return lost ? longest : TB_VALUE_DRAW;
+}
+
+forceinline static void atomic_max(std::atomic<u32>& a, u32 v) {
+    u32 current = a.load(std::memory_order_relaxed);
+    while (current < v && !a.compare_exchange_weak(current, v, std::memory_order_relaxed)) { }
+}
+
+// call fn(idx) for the index of the given position and its diagonal twin, if any
+template<typename F>
+forceinline static void for_each_index(GenTable* t, const Sq* sq, F&& fn) {
+    Sq normalized[TCTB_MAX_PIECES];
+    memcpy(normalized, sq, t->material.count);
+    const i64 idx = encode(t->material, t->hasPawns, normalized);
+    if (idx < 0) {
+        return;
+    }
+
+    fn(idx);
+    if (!t->hasPawns && has_diagonal_twin(t->material, normalized)) {
+        for (u8 i = 0; i < t->material.count; i++) {
+            normalized[i] = transpose(normalized[i]);
+        }
+
+        const i64 twin = encode(t->material, t->hasPawns, normalized);
+        if (twin >= 0 && twin != idx) {
+            fn(twin);
+        }
+    }
+}
+
+// run the retrograde analysis, all conversion tables have to be loaded. Iteration n finds the
+// positions with a DTM of n plies from the positions with a DTM of n - 1: the predecessors of
+// a loss are wins, the predecessors of a win are losses if all their other moves lose as well
+static void retrograde(GenTable* t, u32 threads, GenerationStats* stats) {
+    const Material& m = t->material;
+    const u64 size = t->size;
+    t->values[WHITE].assign(size, TB_VALUE_DRAW);
+    t->values[BLACK].assign(size, TB_VALUE_DRAW);
+
+    std::atomic<u32> maxValue = 0;
+    parallel_for(2 * size, threads, 1 << 14, [&](u64 begin, u64 end) {
+        u32 localMax = 0;
+        for (u64 i = begin; i < end; i++) {
+            const Color stm = i >= size;
+            const u8 v = initial_value(t, i % size, stm);
+            t->values[stm][i % size] = v;
+            if (value_is_decided(v)) localMax = MAX(localMax, v);
+        }
+
+        atomic_max(maxValue, localMax);
+    });
+
+    u32 n = 1;
+    for (; n <= maxValue.load() && n < TB_VALUE_MAX; n++) {
+        parallel_for(2 * size, threads, 1 << 14, [&](u64 begin, u64 end) {
+            u32 localMax = 0;
+            Sq sq[TCTB_MAX_PIECES];
+            Sq twin[TCTB_MAX_PIECES];
+            for (u64 i = begin; i < end; i++) {
+                const Color stm = i >= size;
+                if (t->values[stm][i % size] != n) {
+                    continue;
+                }
+
+                decode(m, t->hasPawns, i % size, sq);
+                std::vector<u8>& predecessors = t->values[!stm];
+                for_each_unmove(m, sq, !stm, [&](const Sq* before) {
+                    // the side which just moved wins by this move
+                    if (n & 1) {
+                        for_each_index(t, before, [&](u64 q) {
+                            std::atomic_ref<u8> ref(predecessors[q]);
+                            u8 current = ref.load(std::memory_order_relaxed);
+                            while (current == TB_VALUE_DRAW || (value_is_win(current) && current > n + 1)) {
+                                if (ref.compare_exchange_weak(current, n + 1, std::memory_order_relaxed)) {
+                                    localMax = MAX(localMax, n + 1);
+                                    break;
+                                }
+                            }
+                        });
+
+                        return;
+                    }
+
+                    // the side which just moved loses if all its other moves lose too,
+                    // the diagonal twin is verified separately
+                    auto try_loss = [&](const Sq* position) {
+                        Sq normalized[TCTB_MAX_PIECES];
+                        memcpy(normalized, position, m.count);
+                        const i64 q = encode(m, t->hasPawns, normalized);
+                        if (q < 0) {
+                            return;
+                        }
+
+                        std::atomic_ref<u8> ref(predecessors[q]);
+                        if (ref.load(std::memory_order_relaxed) != TB_VALUE_DRAW) {
+                            return;
+                        }
+
+                        const u8 v = verify_loss(t, position, !stm, n);
+                        u8 expected = TB_VALUE_DRAW;
+                        if (v != TB_VALUE_DRAW && ref.compare_exchange_strong(expected, v, std::memory_order_relaxed)) {
+                            localMax = MAX(localMax, v);
+                        }
+                    };
+
+                    try_loss(before);
+                    Sq normalized[TCTB_MAX_PIECES];
+                    memcpy(normalized, before, m.count);
+                    normalize(m, t->hasPawns, normalized);
+                    if (!t->hasPawns && has_diagonal_twin(m, normalized)) {
+                        for (u8 j = 0; j < m.count; j++) twin[j] = transpose(normalized[j]);
+                        try_loss(twin);
+                    }
+                });
+            }
+
+            atomic_max(maxValue, localMax);
+        });
+    }
+
+    if (n >= TB_VALUE_MAX) {
+        log<WARN>(P, "Table %s has mates beyond %d plies, stored as draws", m.name().c_str(), TB_VALUE_MAX - 1);
+    }
+
+    stats->iterations = n - 1;
+    for (Color stm : { WHITE, BLACK }) {
+        for (u8 v : t->values[stm]) {
+            if (v == TB_VALUE_INVALID) stats->invalid++;
+            else if (v == TB_VALUE_DRAW) stats->draws++;
+            else if (value_is_win(v)) stats->wins++;
+            else stats->losses++;
+
+            if (value_is_decided(v)) stats->longestMate = MAX(stats->longestMate, (u32)value_dtm(v));
+        }
+    }
+}
+
+/* ------------- File format ------------- */
+
+// the file header, followed by the block offsets of both sides to move (black first), relative
+// to the end of the offsets, and then the blocks
+struct TableHeader {
+    u32 magic;
+    u32 version;
+    char material[16];
+    u64 size;       // positions per side to move
+    u32 blockSize;  // positions per block
+    u32 blockCount; // blocks per side to move
+    u8 reserved[24];
+};
+
+static_assert(sizeof(TableHeader) == 64);
+
+// a block is stored as runs or as bit packed indices into a dictionary of the values in the block,
+// whichever is smaller. The first byte is 0 for runs, followed by (run length - 1, value) pairs, or
+// the size of the dictionary followed by the dictionary and the indices, least significant bit first
+#define BLOCK_RUNS 0
+
+forceinline static u8 index_bits(u32 symbols) {
+    u8 bits = 0;
+    while ((1U << bits) < symbols) bits++;
+    return bits;
+}
+
+static void compress_block(const u8* values, u32 n, std::vector<u8>* out) {
+    // invalid positions are never probed, they continue the value before them
+    u8 filled[TCTB_BLOCK_SIZE];
+    u8 previous = TB_VALUE_DRAW;
+    for (u32 i = 0; i < n; i++) {
+        if (values[i] != TB_VALUE_INVALID) {
+            previous = values[i];
+            break;
+        }
+    }
+
+    bool present[256] = { false };
+    u32 runs = 0;
+    for (u32 i = 0; i < n; i++) {
+        filled[i] = values[i] == TB_VALUE_INVALID ? previous : values[i];
+        runs += i == 0 || filled[i] != filled[i - 1] || (i % 256) == 0;
+        present[filled[i]] = true;
+        previous = filled[i];
+    }
+
+    u8 code[256];
+    u8 dictionary[256];
+    u32 symbols = 0;
+    for (u32 v = 0; v < 256; v++) {
+        if (present[v]) {
+            code[v] = symbols;
+            dictionary[symbols++] = v;
+        }
+    }
+
+    const u8 bits = index_bits(symbols);
+    const u64 packedSize = 1 + symbols + (n * bits + 7) / 8 + 1;
+    if (1 + 2 * runs <= packedSize) {
+        out->push_back(BLOCK_RUNS);
+        u32 run = 0;
+        for (u32 i = 0; i < n; i++) {
+            if (run > 0 && (filled[i] != filled[i - 1] || run == 256)) {
+                out->push_back(run - 1);
+                out->push_back(filled[i - 1]);
+                run = 0;
+            }
+
+            run++;
+        }
+
+        out->push_back(run - 1);
+        out->push_back(filled[n - 1]);
+        return;
+    }
+
+    out->push_back(symbols);
+    out->insert(out->end(), dictionary, dictionary + symbols);
+
+    // padded by a byte, so each index can be read as two bytes
+    const u64 start = out->size();
+    out->resize(start + (n * bits + 7) / 8 + 1, 0);
+    for (u32 i = 0; i < n; i++) {
+        const u32 bit = i * bits;
+        const u32 shifted = (u32)code[filled[i]] << (bit & 7);
+        (*out)[start + bit / 8] |= shifted & 0xFF;
+        (*out)[start + bit / 8 + 1] |= shifted >> 8;
+    }
+}
+
+// read the value at the given offset in the block
+forceinline static u8 read_block(const u8* block, const u8* end, u32 offset) {
+    if (block[0] == BLOCK_RUNS) {
+        for (const u8* p = block + 1; p < end; p += 2) {
+            if (offset <= p[0]) {
+                return p[1];
+            }
+
+            offset -= p[0] + 1;
+        }
+
+        return TB_VALUE_INVALID;
+    }
+
+    const u8 bits = index_bits(block[0]);
+    const u8* indices = block + 1 + block[0];
+    const u32 bit = offset * bits;
+    const u32 word = indices[bit / 8] | ((u32)indices[bit / 8 + 1] << 8);
+    return block[1 + ((word >> (bit & 7)) & ((1U << bits) - 1))];
+}
+
+static void decompress_block(const u8* block, const u8* end, u32 n, u8* out) {
+    if (block[0] == BLOCK_RUNS) {
+        u32 i = 0;
+        for (const u8* p = block + 1; p < end && i < n; p += 2) {
+            const u32 run = MIN((u32)p[0] + 1, n - i);
+            memset(out + i, p[1], run);
+            i += run;
+        }
+
+        return;
+    }
+
+    for (u32 i = 0; i < n; i++) {
+        out[i] = read_block(block, end, i);
+    }
+}
+
+static std::string file_name(const Material& m) {
+    return m.name() + ".tctb";
+}
+
+static bool write_table(GenTable* t, const std::string& path, u64* fileSize) {
+    TableHeader header = { };
+    header.magic = TCTB_MAGIC;
+    header.version = TCTB_VERSION;
+    strncpy(header.material, t->material.name().c_str(), sizeof(header.material) - 1);
+    header.size = t->size;
+    header.blockSize = TCTB_BLOCK_SIZE;
+    header.blockCount = (t->size + TCTB_BLOCK_SIZE - 1) / TCTB_BLOCK_SIZE;
+
+    std::vector<u64> offsets;
+    std::vector<u8> data;
+    for (Color stm : { BLACK, WHITE }) {
+        for (u64 block = 0; block < header.blockCount; block++) {
+            offsets.push_back(data.size());
+
+            const u64 begin = block * TCTB_BLOCK_SIZE;
+            compress_block(t->values[stm].data() + begin, MIN(t->size - begin, (u64)TCTB_BLOCK_SIZE), &data);
+        }
+    }
+
+    offsets.push_back(data.size());
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)offsets.data(), offsets.size() * sizeof(u64));
+    file.write((const char*)data.data(), data.size());
+    *fileSize = sizeof(header) + offsets.size() * sizeof(u64) + data.size();
+    return file.good();
+}
+
+forceinline static const u64* offsets_of(const TableHeader* header) {
+    return (const u64*)(header + 1);
+}
+
+forceinline static const u8* blocks_of(const TableHeader* header) {
+    return (const u8*)(offsets_of(header) + 2 * header->blockCount + 1);
+}
+
+// validate the mapped file of the given material, returns the header
+static const TableHeader* check_table(const MappedFile& file, const Material& m) {
+    const TableHeader* header = (const TableHeader*)file.data;
+    if (file.size < sizeof(TableHeader) || header->magic != TCTB_MAGIC || header->version != TCTB_VERSION ||
+        header->size != m.size() || header->blockSize != TCTB_BLOCK_SIZE ||
+        header->blockCount != (header->size + TCTB_BLOCK_SIZE - 1) / TCTB_BLOCK_SIZE) {
+        return nullptr;
+    }
+
+    const u64 offsetsSize = (2 * header->blockCount + 1) * sizeof(u64);
+    if (file.size < sizeof(TableHeader) + offsetsSize ||
+        file.size != sizeof(TableHeader) + offsetsSize + offsets_of(header)[2 * header->blockCount]) {
+        return nullptr;
+    }
+
+    return header;
+}
+
+// read a single value of the given side to move from the compressed blocks
+static u8 read_value(const TableHeader* header, Color stm, u64 idx) {
+    const u64* offsets = offsets_of(header) + stm * header->blockCount + idx / TCTB_BLOCK_SIZE;
+    return read_block(blocks_of(header) + offsets[0], blocks_of(header) + offsets[1], idx % TCTB_BLOCK_SIZE);
+}
+
+static bool load_table(GenTable* t, const std::string& path) {
+    MappedFile file;
+    if (!file.map(path.c_str())) {
+        return false;
+    }
+
+    const TableHeader* header = check_table(file, t->material);
+    if (!header) {
+        log<WARN>(P, "Corrupted table file %s", path.c_str());
+        file.unmap();
+        return false;
+    }
+
+    const u64* offsets = offsets_of(header);
+    for (Color stm : { BLACK, WHITE }) {
+        t->values[stm].resize(t->size);
+        for (u64 block = 0; block < header->blockCount; block++) {
+            const u64 i = stm * header->blockCount + block;
+            const u64 begin = block * TCTB_BLOCK_SIZE;
+            decompress_block(blocks_of(header) + offsets[i], blocks_of(header) + offsets[i + 1],
+                             MIN(t->size - begin, (u64)TCTB_BLOCK_SIZE), t->values[stm].data() + begin);
+        }
+    }
+
+    file.unmap();
+    return true;
+}
+
+/* ------------- Generator ------------- */
+
+// load the tables the given table converts into from the directory, sharing the ones already loaded
+static bool load_conversions(GenTable* table, const std::string& dir, std::unordered_map<u64, std::unique_ptr<GenTable>>* loaded, u64* memory) {
+    const Material& m = table->material;
+    bool ok = true;
+    for_each_conversion(m, [&](i8 captured, i8 promoted, PieceType promotionType) {
+        if (!ok || (captured < 0 && promoted < 0)) {
+            return;
+        }
+
+        Material converted = converted_material(m, captured, promoted, promotionType);
+        Conversion& c = table->conversion(captured, promoted, promotionType);
+        c.swapped = converted.canonicalize();
+        if (converted.count <= 2) {
+            return;
+        }
+
+        auto it = loaded->find(converted.key());
+        if (it == loaded->end()) {
+            auto sub = std::make_unique<GenTable>();
+            sub->material = converted;
+            sub->hasPawns = converted.has_pawns();
+            sub->size = converted.size();
+            if (!load_table(sub.get(), (std::filesystem::path(dir) / file_name(converted)).string())) {
+                ok = false;
+                return;
+            }
+
+            *memory += 2 * sub->size;
+            it = loaded->emplace(converted.key(), std::move(sub)).first;
+        }
+
+        c.table = it->second.get();
+
+        // assign every remaining piece to a free slot of the same piece in the table
+        bool used[TCTB_MAX_PIECES] = { false };
+        for (u8 i = 0; i < m.count; i++) {
+            if (i == captured) continue;
+            const Piece p = (i == promoted ? (promotionType | COLOR_OF_PIECE(m.pieces[i])) : m.pieces[i]) ^ (c.swapped ? WHITE_PIECE : 0);
+            for (u8 j = 0; j < converted.count; j++) {
+                if (!used[j] && converted.pieces[j] == p) {
+                    used[j] = true;
+                    c.slot[i] = j;
+                    break;
+                }
+            }
+        }
+    });
+
+    return ok;
+}
+
+struct Generator {
+    std::string dir;
+    u32 threads;
+    std::vector<GenerationStats>* stats;
+
+    // generate the table into the directory if it is not there yet, after all tables it converts into
+    bool ensure(Material m) {
+        m.canonicalize();
+        const std::string path = (std::filesystem::path(dir) / file_name(m)).string();
+        if (m.count <= 2 || std::filesystem::exists(path)) {
+            return true;
+        }
+
+        bool ok = true;
+        for_each_conversion(m, [&](i8 captured, i8 promoted, PieceType promotionType) {
+            if (captured >= 0 || promoted >= 0) {
+                ok = ok && ensure(converted_material(m, captured, promoted, promotionType));
+            }
+        });
+
+        return ok && build(m, path);
+    }
+
+    // load the tables converted into, generate the table and write it
+    bool build(const Material& m, const std::string& path) {
+        const auto start = std::chrono::steady_clock::now();
+
+        auto table = std::make_unique<GenTable>();
+        table->material = m;
+        table->hasPawns = m.has_pawns();
+        table->size = m.size();
+
+        std::unordered_map<u64, std::unique_ptr<GenTable>> loaded;
+        u64 memory = 2 * table->size;
+        if (!load_conversions(table.get(), dir, &loaded, &memory)) {
+            log<WARN>(P, "Missing tables to generate %s", m.name().c_str());
+            return false;
+        }
+
+        GenerationStats result;
+        result.name = m.name();
+        result.positions = 2 * table->size;
+        result.memory = memory;
+        retrograde(table.get(), threads, &result);
+
+        const bool written = write_table(table.get(), path, &result.fileSize);
+        result.seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        if (stats) {
+            stats->push_back(result);
+        }
+
+        return written;
+    }
+};
+
+bool generate(const std::string& material, const std::string& dir, u32 threads, std::vector<GenerationStats>* stats) {
+    Material m;
+    if (!m.parse(material)) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+
+    Generator generator { dir, MAX(threads, 1U), stats };
+    return generator.ensure(m);
+}
+
+/* ------------- Probing ------------- */
+
+struct ProbeTable {
+    Material material;
+    bool hasPawns;
+    PositionHash key;
+    PositionHash key2; // the key with the colors swapped
+    std::string path;
+
+    std::atomic<bool> ready;
+    MappedFile file;
+    const TableHeader* header = nullptr;
+};
+
+static std::deque<ProbeTable> tables;
+static std::unordered_map<PositionHash, ProbeTable*> tablesByKey;
+static std::mutex mapMutex;
+
+// map the file of the given table on first use, returns whether it is usable
+static bool map_table(ProbeTable* t) {
+    std::lock_guard<std::mutex> lock(mapMutex);
+    if (t->ready.load(std::memory_order_relaxed)) {
+        return t->header != nullptr;
+    }
+
+    if (t->file.map(t->path.c_str())) {
+        t->header = check_table(t->file, t->material);
+        if (!t->header) {
+            log<WARN>(P, "Corrupted table file %s", t->path.c_str());
+            t->file.unmap();
+        }
+    }
+
+    t->ready.store(true, std::memory_order_release);
+    return t->header != nullptr;
+}
+
+u32 init(const std::string& dir) {
+    for (ProbeTable& table : tables) {
+        table.file.unmap();
+    }
+
+    tablesByKey.clear();
+    tables.clear();
+    largestTable = 0;
+
+    if (dir.empty() || dir == "<empty>") {
+        return 0;
+    }
+
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(dir, error)) {
+        Material m;
+        if (!file.is_regular_file() || file.path().extension() != ".tctb" || !m.parse(file.path().stem().string())) {
+            continue;
+        }
+
+        ProbeTable& table = tables.emplace_back();
+        table.material = m;
+        table.hasPawns = m.has_pawns();
+        table.key = m.key();
+        table.path = file.path().string();
+        table.ready.store(false);
+
+        Piece list[TCTB_MAX_PIECES];
+        for (u8 i = 0; i < m.count; i++) list[i] = m.pieces[i] ^ WHITE_PIECE;
+        Material swapped;
+        swapped.set(list, m.count);
+        table.key2 = swapped.key();
+
+        tablesByKey[table.key] = &table;
+        tablesByKey[table.key2] = &table;
+        largestTable = MAX(largestTable, m.count);
+    }
+
+    return tables.size();
+}
+
+bool probe(Board* board, i8* outcome, u32* dtm) {
+    const PositionHash key = board->material_key();
+    auto it = tablesByKey.find(key);
+    if (it == tablesByKey.end()) {
+        return false;
+    }
+
+    ProbeTable* t = it->second;
+    if (!t->ready.load(std::memory_order_acquire) ? !map_table(t) : t->header == nullptr) {
+        return false;
+    }
+
+    // collect the squares in the material order of the table, mirrored if the colors are swapped
+    const Material& m = t->material;
+    const bool swapped = key != t->key;
+    Bitboard remaining[2][6];
+    for (Color color : { WHITE, BLACK }) {
+        for (u8 pt = PAWN; pt <= KING; pt++) {
+            remaining[color][pt] = board->pieces(color, (PieceType)pt);
+        }
+    }
+
+    Sq sq[TCTB_MAX_PIECES];
+    for (u8 i = 0; i < m.count; i++) {
+        Bitboard& bb = remaining[IS_WHITE_PIECE(m.pieces[i]) ^ swapped][TYPE_OF_PIECE(m.pieces[i])];
+        if (!bb) {
+            return false;
+        }
+
+        sq[i] = _pop_lsb(bb) ^ (swapped ? 56 : 0);
+    }
+
+    const i64 idx = encode(m, t->hasPawns, sq);
+    if (idx < 0) {
+        return false;
+    }
+
+    const u8 v = read_value(t->header, board->turn ^ swapped, idx);
+    if (v == TB_VALUE_INVALID) {
+        return false;
+    }
+
+    *outcome = !value_is_decided(v) ? 0 : value_is_win(v) ? 1 : -1;
+    *dtm = value_is_decided(v) ? value_dtm(v) : 0;
+    return true;
+}
+
+}
\ No newline at end of file
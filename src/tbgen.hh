@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hh"
+#include "platform.hh"
+#include "piece.hh"
+
+/*
+    In-tree endgame tablebases of up to 5 men, generated by multi-threaded retrograde analysis
+    and probed by the engine from its own compact .tctb files.
+
+    A table stores the distance to mate (DTM) in plies for both sides to move, so the win, draw
+    or loss follows from it as well. Positions are indexed by the king pair, reduced by the board
+    symmetries (462 pairs without pawns, 1806 with pawns), followed by 64 squares per piece and
+    48 per pawn. The stored values are run length encoded in blocks of TCTB_BLOCK_SIZE positions,
+    so the files can be memory mapped and probed without decompressing them.
+
+    En passant and castling are not known to the tables, neither is the 50 move rule.
+ */
+
+namespace tc { struct Board; }
+
+namespace tc::tbgen {
+
+#define TCTB_MAX_PIECES 5
+#define TCTB_MAGIC      0x42544354 // "TCTB"
+#define TCTB_VERSION    1
+#define TCTB_BLOCK_SIZE 1024       // positions per compressed block
+
+/* The stored values are the DTM in plies plus one, an odd DTM being a win for the side to move and an even DTM a loss */
+#define TB_VALUE_DRAW    0
+#define TB_VALUE_MAX     254
+#define TB_VALUE_INVALID 255
+
+forceinline bool value_is_decided(u8 v) { return v != TB_VALUE_DRAW && v != TB_VALUE_INVALID; }
+forceinline u8 value_dtm(u8 v) { return v - 1; }
+forceinline bool value_is_win(u8 v) { return value_is_decided(v) && (value_dtm(v) & 1); }
+
+/// @brief The pieces of a table, the white side starting at index 0 and the black side at whiteCount.
+/// Each side starts with its king, followed by the other pieces ordered from queen to pawn.
+struct Material {
+    u8 count = 0;
+    u8 whiteCount = 0;
+    Piece pieces[TCTB_MAX_PIECES];
+
+    /// @brief Parse a material string such as "KRPvKR", returns whether it was valid.
+    bool parse(const std::string& str);
+
+    /// @brief Set the pieces from an unordered list, which has to contain both kings.
+    void set(const Piece* list, u8 n);
+
+    /// @brief Swap the colors if black is the stronger side, so each table is only generated once.
+    /// @return Whether the colors were swapped.
+    bool canonicalize();
+
+    std::string name() const;
+    u64 key() const; // the material key of a board with these pieces
+    bool has_pawns() const;
+
+    /// @brief The amount of indexed positions per side to move.
+    u64 size() const;
+};
+
+/// @brief The results of generating a single table.
+struct GenerationStats {
+    std::string name;
+    u64 positions = 0; // indexed positions of both sides to move
+    u64 invalid = 0;
+    u64 wins = 0;
+    u64 losses = 0;
+    u64 draws = 0;
+    u32 longestMate = 0; // in plies
+    u32 iterations = 0;
+    u64 memory = 0;      // bytes of table data held while generating, including the tables converted into
+    u64 fileSize = 0;
+    f64 seconds = 0;
+};
+
+/// @brief Generate the table for the given material into the given directory, along with every table
+/// it converts into by captures and promotions which is not in the directory yet.
+/// @param stats Receives the results of every table generated, in order.
+/// @return Whether the material was valid and all tables were written.
+bool generate(const std::string& material, const std::string& dir, u32 threads, std::vector<GenerationStats>* stats);
+
+/// @brief The most pieces of any table found on init, 0 if probing is disabled.
+extern u8 largestTable;
+
+forceinline u8 max_pieces() { return largestTable; }
+
+/// @brief (Re)initialize probing with the .tctb files in the given directory, the files are only
+/// memory mapped on their first probe. An empty path or "<empty>" disables probing.
+/// @return The amount of tables found.
+u32 init(const std::string& dir);
+
+/// @brief Probe the tables for the given position, which must not have castling rights or an en passant square.
+/// @param outcome Set to 1 if the side to move wins, -1 if it loses and 0 for a draw.
+/// @param dtm Set to the plies until mate if the position is decided.
+/// @return Whether the position was found in the tables.
+bool probe(Board* board, i8* outcome, u32* dtm);
+
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "types.hh"
+#include "platform.hh"
+#include "move.hh"
+
+/*
+    Decides how long a search may take from the limits given by the UCI go command. The soft
+    limit is checked between iterations and scaled by how settled the best move is, the hard
+    limit is checked by the search itself every few thousand nodes and aborts it. While pondering
+    neither applies, the clock is restarted on ponderhit and the limits hold from then on.
+ */
+
+namespace tc {
+
+#define TIME_CHECK_INTERVAL 2048 // the nodes searched between two looks at the clock, a power of 2
+#define MOVE_OVERHEAD       30   // the milliseconds reserved per move for communication with the GUI
+#define DEFAULT_MOVES_TO_GO 40   // the moves the remaining time is split over without a movestogo
+#define MAX_MOVES_TO_GO     50
+#define HARD_LIMIT_SCALE    4    // how many times the soft limit the hard limit allows
+
+/// @brief The limits of a search as given by the UCI go command, zero if not given.
+/// All times are in milliseconds.
+struct SearchLimits {
+    i64 time[2] = { 0, 0 }; // The remaining time per color
+    i64 inc[2] = { 0, 0 };  // The increment per move per color
+    i32 movesToGo = 0;      // The moves until the next time control
+    i64 moveTime = 0;       // The exact time to search for
+    u32 depth = 0;          // The deepest iteration to search
+    u64 nodes = 0;          // The most nodes to search
+    bool infinite = false;  // Search until stopped
+    bool ponder = false;    // Search on the opponents time until ponderhit or stopped
+
+    /// @brief Whether the search is limited by time for the given side to move.
+    forceinline bool timed(Color turn) const { return !infinite && (moveTime > 0 || time[turn] > 0); }
+};
+
+/// @brief Keeps the deadlines of one search. The clock and the ponder state are changed
+/// by the input thread while the search reads them.
+struct TimeManager {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<Clock::rep> start { 0 }; // The ticks of the clock the search was started at
+    std::atomic<bool> pondering { false };
+    i64 softLimit = 0; // The time after which no new iteration is started, scaled by the best move stability. 0 if unlimited or the move time is fixed
+    i64 hardLimit = 0; // The time after which the search is aborted. 0 if unlimited
+    u64 nodeLimit = 0; // The nodes after which the search is aborted. 0 if unlimited
+
+    Move lastBestMove = NULL_MOVE;
+    u32 stability = 0; // The iterations in a row the best move stayed the same
+
+    /// @brief Start the clock and compute the deadlines for the given side to move.
+    void init(SearchLimits const& limits, Color turn) {
+        start.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        pondering.store(limits.ponder, std::memory_order_relaxed);
+        softLimit = hardLimit = 0;
+        nodeLimit = limits.nodes;
+        lastBestMove = NULL_MOVE;
+        stability = 0;
+
+        if (!limits.timed(turn)) {
+            return;
+        }
+
+        // a fixed move time is an exact budget, it is only ended by the hard limit
+        if (limits.moveTime > 0) {
+            hardLimit = std::max<i64>(limits.moveTime - MOVE_OVERHEAD, 1);
+            return;
+        }
+
+        // split the remaining time over the moves until the next time control, most of the increment can be
+        // spent on every move. the hard limit allows to finish an iteration which takes much longer than expected
+        const i64 remaining = std::max<i64>(limits.time[turn] - MOVE_OVERHEAD, 1);
+        const i64 movesToGo = limits.movesToGo > 0 ? std::min(limits.movesToGo, MAX_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+        const i64 base = remaining / movesToGo + limits.inc[turn] * 3 / 4;
+        hardLimit = std::max<i64>(std::min(base * HARD_LIMIT_SCALE, remaining * 8 / 10), 1);
+        softLimit = std::min(base, hardLimit);
+    }
+
+    /// @brief The opponent played the move we pondered on, the search goes on under the limits from now on.
+    void ponderhit() {
+        start.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        pondering.store(false, std::memory_order_release);
+    }
+
+    /// @brief The milliseconds since the search was started.
+    forceinline i64 elapsed() const {
+        const Clock::duration duration(Clock::now().time_since_epoch().count() - start.load(std::memory_order_relaxed));
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    }
+
+    /// @brief Whether the search has to be aborted, only called every TIME_CHECK_INTERVAL nodes.
+    forceinline bool hard_expired(u64 nodes) const {
+        if (pondering.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        return (nodeLimit > 0 && nodes >= nodeLimit) || (hardLimit > 0 && elapsed() >= hardLimit);
+    }
+
+    /// @brief Whether to start no further iteration after one was completed with the given best move.
+    /// The soft limit is stretched when the best move keeps changing or shares the root nodes with
+    /// other moves, and shrunk when it stays the same and took nearly all of the nodes.
+    /// @param bestMoveNodes The nodes spent below the best root move in the last iteration.
+    /// @param iterationNodes The nodes spent in the last iteration.
+    bool should_stop(Move bestMove, u64 bestMoveNodes, u64 iterationNodes) {
+        stability = bestMove.eq(lastBestMove) ? stability + 1 : 0;
+        lastBestMove = bestMove;
+
+        if (softLimit == 0 || pondering.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        const f64 stabilityScale = 1.25 - 0.1 * std::min<u32>(stability, 6);
+        const f64 bestMoveFraction = iterationNodes > 0 ? (f64)bestMoveNodes / (f64)iterationNodes : 0.5;
+        const f64 nodeScale = (1.5 - bestMoveFraction) * 1.35;
+        const i64 scaledLimit = std::min((i64)(softLimit * stabilityScale * nodeScale), hardLimit);
+        return elapsed() >= scaledLimit;
+    }
+};
+
+}
@@ -0,0 +1,341 @@
+#include "trainer.hh"
+#include "batcheval.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace tc::trainer {
+
+/* ------------- SIMD kernels ------------- */
+
+// dst += src over one hidden layer
+forceinline void add_column(f32* dst, const f32* src) {
+#ifdef __AVX2__
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        _mm256_store_ps(dst + i, _mm256_add_ps(_mm256_load_ps(dst + i), _mm256_load_ps(src + i)));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i++) dst[i] += src[i];
+#endif
+}
+
+// the dot product of the clipped ReLU of the accumulator and the output weights
+forceinline f32 activated_dot(const f32* acc, const f32* weights) {
+#ifdef __AVX2__
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        const __m256 h = _mm256_min_ps(_mm256_max_ps(_mm256_load_ps(acc + i), zero), one);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(h, _mm256_load_ps(weights + i)));
+    }
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0b01));
+    return _mm_cvtss_f32(s);
+#else
+    f32 sum = 0;
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i++) sum += MIN(MAX(acc[i], 0.0f), 1.0f) * weights[i];
+    return sum;
+#endif
+}
+
+// the backward pass of the output layer for one perspective, given the gradient of the output:
+// grad += d * h and delta = d * w where the clipped ReLU is not saturated
+forceinline void output_backward(f32 d, const f32* acc, const f32* weights, f32* weightGrad, f32* delta) {
+#ifdef __AVX2__
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 dv = _mm256_set1_ps(d);
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i += 8) {
+        const __m256 a = _mm256_load_ps(acc + i);
+        const __m256 h = _mm256_min_ps(_mm256_max_ps(a, zero), one);
+        _mm256_store_ps(weightGrad + i, _mm256_add_ps(_mm256_load_ps(weightGrad + i), _mm256_mul_ps(dv, h)));
+
+        const __m256 active = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), _mm256_cmp_ps(a, one, _CMP_LT_OQ));
+        _mm256_store_ps(delta + i, _mm256_and_ps(active, _mm256_mul_ps(dv, _mm256_load_ps(weights + i))));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+        weightGrad[i] += d * MIN(MAX(acc[i], 0.0f), 1.0f);
+        delta[i] = acc[i] > 0 && acc[i] < 1 ? d * weights[i] : 0;
+    }
+#endif
+}
+
+/* ------------- Network ------------- */
+
+void FloatNetwork::init_random(u64 seed) {
+    std::mt19937_64 rng(seed);
+
+    // scaled by the amount of inputs active at once rather than the total amount of inputs
+    std::normal_distribution<f32> ftDist(0.0f, 1.0f / std::sqrt(32.0f));
+    std::normal_distribution<f32> outDist(0.0f, 1.0f / std::sqrt((f32)NNUE_HIDDEN_SIZE));
+    for (f32& w : ftWeights) w = ftDist(rng);
+    for (f32& w : outWeights) w = std::clamp(outDist(rng), -TRAIN_OUT_WEIGHT_LIMIT, TRAIN_OUT_WEIGHT_LIMIT);
+    std::fill(std::begin(ftBiases), std::end(ftBiases), 0.0f);
+    outBias = 0;
+}
+
+template<typename T>
+static T quantise(f32 value, f32 scale) {
+    const double q = std::round((double)value * scale);
+    return (T)std::clamp(q, (double)std::numeric_limits<T>::min(), (double)std::numeric_limits<T>::max());
+}
+
+bool FloatNetwork::save(const char* path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    nnue::NetworkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = NNUE_MAGIC;
+    header.version = NNUE_VERSION;
+    header.inputSize = NNUE_INPUT_SIZE;
+    header.hiddenSize = NNUE_HIDDEN_SIZE;
+    file.write((const char*)&header, sizeof(header));
+
+    std::vector<i16> ft(NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE);
+    for (u64 i = 0; i < ft.size(); i++) ft[i] = quantise<i16>(ftWeights[i], NNUE_QA);
+    file.write((const char*)ft.data(), ft.size() * sizeof(i16));
+
+    i16 biases[NNUE_HIDDEN_SIZE];
+    for (u32 i = 0; i < NNUE_HIDDEN_SIZE; i++) biases[i] = quantise<i16>(ftBiases[i], NNUE_QA);
+    file.write((const char*)biases, sizeof(biases));
+
+    i8 out[2 * NNUE_HIDDEN_SIZE];
+    for (u32 i = 0; i < 2 * NNUE_HIDDEN_SIZE; i++) out[i] = quantise<i8>(outWeights[i], NNUE_QB);
+    file.write((const char*)out, sizeof(out));
+
+    // the output bias gets its own 64 byte block
+    u8 last[64] = { };
+    const i32 bias = quantise<i32>(outBias, NNUE_QA * NNUE_QB);
+    memcpy(last, &bias, sizeof(bias));
+    file.write((const char*)last, sizeof(last));
+    return (bool)file;
+}
+
+bool check_export(const FloatNetwork* network, const char* path, const PackedPosition* positions, u64 count, u32 threads, ExportCheck* out) {
+    nnue::Network loaded;
+    if (!loaded.load(path)) {
+        return false;
+    }
+
+    std::vector<i32> evals(count);
+    batch::eval_nnue(&loaded, positions, count, evals.data(), threads);
+
+    // the engine evaluation is ABSOLUTE in eval units, the float output relative in centipawns
+    f64 sum = 0, max = 0;
+    for (u64 i = 0; i < count; i++) {
+        const f64 engine = (f64)SIGN_OF_COLOR(positions[i].turn) * evals[i] * 100 / EVAL_SCALE;
+        const f64 error = std::abs(engine - network->evaluate(&positions[i]));
+        sum += error;
+        max = std::max(max, error);
+    }
+
+    *out = { count, sum / MAX(count, 1ULL), max };
+    return true;
+}
+
+/* ------------- Training ------------- */
+
+// the feature indices of a position per perspective, side to move first
+struct PositionFeatures {
+    u32 indices[2][32];
+    u8 count;
+    Color turn;
+
+    PositionFeatures(const PackedPosition* position) {
+        count = 0;
+        turn = position->turn;
+        position->for_each_piece([&](Piece p, Sq sq) {
+            indices[0][count] = nnue::feature_index(turn, p, sq);
+            indices[1][count++] = nnue::feature_index(!turn, p, sq);
+        });
+    }
+};
+
+static forceinline f32 sigmoid(f32 x) {
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+// the forward pass of one position, fills the accumulators and returns the raw output
+static forceinline f32 forward(const FloatNetwork* net, PositionFeatures const& features, f32 acc[2][NNUE_HIDDEN_SIZE]) {
+    for (u8 side = 0; side < 2; side++) {
+        memcpy(acc[side], net->ftBiases, sizeof(acc[side]));
+        for (u8 i = 0; i < features.count; i++) {
+            add_column(acc[side], net->ftWeights + features.indices[side][i] * NNUE_HIDDEN_SIZE);
+        }
+    }
+
+    return activated_dot(acc[0], net->outWeights) + activated_dot(acc[1], net->outWeights + NNUE_HIDDEN_SIZE) + net->outBias;
+}
+
+f32 FloatNetwork::evaluate(const PackedPosition* position) const {
+    alignas(64) f32 acc[2][NNUE_HIDDEN_SIZE];
+    return forward(this, PositionFeatures(position), acc) * NNUE_OUTPUT_SCALE;
+}
+
+// the forward and backward pass of one position, returns its loss
+static f32 train_position(const FloatNetwork* net, FloatNetwork* grad, const PackedPosition* position, TrainOptions const& options) {
+    alignas(64) f32 acc[2][NNUE_HIDDEN_SIZE];
+    alignas(64) f32 delta[2][NNUE_HIDDEN_SIZE];
+
+    const PositionFeatures features(position);
+    const f32 output = forward(net, features, acc);
+
+    // the target relative to the side to move, the labels are from the perspective of white
+    const f32 sign = SIGN_OF_COLOR(features.turn);
+    const f32 result = features.turn ? position->result * 0.5f : 1.0f - position->result * 0.5f;
+    const f32 target = options.lambda * sigmoid(sign * position->score / options.evalScale) + (1 - options.lambda) * result;
+
+    const f32 outputScale = NNUE_OUTPUT_SCALE / options.evalScale;
+    const f32 predicted = sigmoid(output * outputScale);
+    const f32 error = predicted - target;
+    const f32 d = 2 * error * predicted * (1 - predicted) * outputScale;
+
+    grad->outBias += d;
+    output_backward(d, acc[0], net->outWeights, grad->outWeights, delta[0]);
+    output_backward(d, acc[1], net->outWeights + NNUE_HIDDEN_SIZE, grad->outWeights + NNUE_HIDDEN_SIZE, delta[1]);
+
+    // only the columns of the active features receive a gradient
+    for (u8 side = 0; side < 2; side++) {
+        add_column(grad->ftBiases, delta[side]);
+        for (u8 i = 0; i < features.count; i++) {
+            add_column(grad->ftWeights + features.indices[side][i] * NNUE_HIDDEN_SIZE, delta[side]);
+        }
+    }
+
+    return error * error;
+}
+
+Trainer::Trainer(TrainOptions const& options) : options(options) {
+    network = std::make_unique<FloatNetwork>();
+    momentum = std::make_unique<FloatNetwork>();
+    velocity = std::make_unique<FloatNetwork>();
+    network->init_random(options.seed);
+
+    for (u32 i = 0; i < MAX(options.threads, 1U); i++) {
+        gradients.push_back(std::make_unique<FloatNetwork>());
+    }
+}
+
+f64 Trainer::train_batch(const PackedPosition* const* positions, u32 count) {
+    const u32 threads = gradients.size();
+    std::vector<f64> losses(threads, 0);
+
+    // each thread takes a contiguous slice of the batch into its own gradient
+    auto work = [&](u32 t) {
+        FloatNetwork* grad = gradients[t].get();
+        memset((void*)grad, 0, sizeof(FloatNetwork));
+
+        const u32 begin = (u64)count * t / threads, end = (u64)count * (t + 1) / threads;
+        f64 loss = 0;
+        for (u32 i = begin; i < end; i++) {
+            loss += train_position(network.get(), grad, positions[i], options);
+        }
+
+        losses[t] = loss;
+    };
+
+    std::vector<std::thread> pool;
+    for (u32 t = 1; t < threads; t++) pool.emplace_back(work, t);
+    work(0);
+    for (std::thread& thread : pool) thread.join();
+
+    // sum the gradients into the first and take the Adam step on the mean
+    f32* g = gradients[0]->parameters();
+    for (u32 t = 1; t < threads; t++) {
+        const f32* other = gradients[t]->parameters();
+        for (u64 i = 0; i < FloatNetwork::parameterCount; i++) g[i] += other[i];
+    }
+
+    constexpr f32 beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    steps++;
+    const f32 stepSize = options.learningRate * std::sqrt(1 - std::pow(beta2, (f32)steps)) / (1 - std::pow(beta1, (f32)steps));
+    const f32 invCount = 1.0f / count;
+
+    f32* w = network->parameters();
+    f32* m = momentum->parameters();
+    f32* v = velocity->parameters();
+    for (u64 i = 0; i < FloatNetwork::parameterCount; i++) {
+        const f32 grad = g[i] * invCount;
+        m[i] = beta1 * m[i] + (1 - beta1) * grad;
+        v[i] = beta2 * v[i] + (1 - beta2) * grad * grad;
+        w[i] -= stepSize * m[i] / (std::sqrt(v[i]) + epsilon);
+    }
+
+    for (f32& weight : network->outWeights) {
+        weight = std::clamp(weight, -TRAIN_OUT_WEIGHT_LIMIT, TRAIN_OUT_WEIGHT_LIMIT);
+    }
+
+    f64 loss = 0;
+    for (f64 l : losses) loss += l;
+    return loss;
+}
+
+void Trainer::train(const PackedPosition* data, u64 count, std::function<void(EpochStats const&)> report) {
+    std::vector<u64> order(count);
+    for (u64 i = 0; i < count; i++) order[i] = i;
+
+    std::vector<const PackedPosition*> batch(options.batchSize);
+    std::mt19937_64 rng(options.seed);
+    for (u32 epoch = 1; epoch <= options.epochs; epoch++) {
+        const auto start = std::chrono::steady_clock::now();
+        std::shuffle(order.begin(), order.end(), rng);
+
+        f64 loss = 0;
+        for (u64 begin = 0; begin < count; begin += options.batchSize) {
+            const u32 n = MIN(count - begin, (u64)options.batchSize);
+            for (u32 i = 0; i < n; i++) batch[i] = &data[order[begin + i]];
+            loss += train_batch(batch.data(), n);
+        }
+
+        if (report) {
+            const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            report({ epoch, count, loss / MAX(count, 1ULL), seconds });
+        }
+    }
+}
+
+void random_positions(PackedPosition* out, u64 count, u64 seed) {
+    std::mt19937_64 rng(seed);
+    for (u64 i = 0; i < count; i++) {
+        PackedPosition& position = out[i];
+        memset(&position, 0, sizeof(position));
+
+        // both kings and up to 30 other pieces, no pawns on the back ranks
+        Piece squares[64];
+        std::fill(std::begin(squares), std::end(squares), NULL_PIECE);
+        const u32 pieces = 2 + rng() % 31;
+        for (u32 j = 0; j < pieces; j++) {
+            const Piece p = j < 2 ? (KING | PIECE_COLOR_FOR(j)) : ((rng() % 5) | PIECE_COLOR_FOR(rng() & 1));
+            Sq sq;
+            do {
+                sq = rng() % 64;
+            } while (squares[sq] != NULL_PIECE || (TYPE_OF_PIECE(p) == PAWN && (RANK(sq) == 0 || RANK(sq) == 7)));
+            squares[sq] = p;
+        }
+
+        u8 n = 0;
+        for (Sq sq = 0; sq < 64; sq++) {
+            if (squares[sq] == NULL_PIECE) continue;
+            position.occupied |= 1ULL << sq;
+            position.pieces[n >> 1] |= (TYPE_OF_PIECE(squares[sq]) | (IS_WHITE_PIECE(squares[sq]) << 3)) << ((n & 1) * 4);
+            n++;
+        }
+
+        position.turn = rng() & 1;
+        position.result = rng() % 3;
+        position.score = (i16)((i32)(rng() % 2001) - 1000);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "types.hh"
+#include "platform.hh"
+#include "nnue.hh"
+#include "packedpos.hh"
+
+/*
+    CPU trainer for the NNUE in nnue.hh, built as its own executable (see train/main.cc).
+
+    The network is trained in float on memory mapped files of PackedPosition records. Only the
+    feature columns of the pieces on the board are touched in both the forward and backward pass,
+    the rest of the passes is dense AVX2 over the hidden layer. Each minibatch is split between
+    the threads, which accumulate into their own gradient before it is summed for the Adam step.
+
+    The target blends the game result with the sigmoid of the search score of the position by
+    lambda, the loss is the squared error against the sigmoid of the network output. The trained
+    network is quantised into the format nnue::Network loads.
+ */
+
+namespace tc::trainer {
+
+// the output weights are quantised to int8, so they are kept within what is representable
+#define TRAIN_OUT_WEIGHT_LIMIT ((f32)127 / NNUE_QB)
+
+#define TRAIN_EXPORT_CHECK_POSITIONS (1 << 16) // the most positions the written network is checked against
+
+/// @brief The network parameters in float, also used for the gradients and optimizer moments.
+struct alignas(64) FloatNetwork {
+    f32 ftWeights[NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE]; // one column per feature, like the quantised network
+    f32 ftBiases[NNUE_HIDDEN_SIZE];
+    f32 outWeights[2 * NNUE_HIDDEN_SIZE];              // side to move perspective first
+    f32 outBias;
+
+    constexpr static u64 parameterCount = NNUE_INPUT_SIZE * NNUE_HIDDEN_SIZE + NNUE_HIDDEN_SIZE + 2 * NNUE_HIDDEN_SIZE + 1;
+
+    forceinline f32* parameters() { return ftWeights; }
+    forceinline const f32* parameters() const { return ftWeights; }
+
+    /// @brief Initialize the weights randomly and the biases to zero.
+    void init_random(u64 seed);
+
+    /// @brief Quantise the network and write it in the file format loaded by nnue::Network.
+    bool save(const char* path) const;
+
+    /// @brief The float output for the given position relative to the side to move, in centipawns.
+    f32 evaluate(const PackedPosition* position) const;
+};
+
+/// @brief How far the evaluations of an exported network are from the float network it was saved from.
+struct ExportCheck {
+    u64 positions;
+    f64 meanError; // in centipawns
+    f64 maxError;  // in centipawns
+};
+
+struct TrainOptions {
+    u32 threads = 1;
+    u32 epochs = 10;
+    u32 batchSize = 16384;
+    f32 learningRate = 0.001f;
+    f32 lambda = 0.5f;      // the weight of the search score against the game result in the target
+    f32 evalScale = 400;    // the centipawns of the sigmoid used for the search score and the output
+    u64 seed = 1;
+};
+
+struct EpochStats {
+    u32 epoch;
+    u64 positions;
+    f64 loss;    // the mean loss over the epoch
+    f64 seconds;
+
+    forceinline f64 positions_per_second() const { return positions / MAX(seconds, (f64)1e-9); }
+};
+
+struct Trainer {
+    TrainOptions options;
+    std::unique_ptr<FloatNetwork> network;
+    std::unique_ptr<FloatNetwork> momentum;
+    std::unique_ptr<FloatNetwork> velocity;
+    std::vector<std::unique_ptr<FloatNetwork>> gradients; // per thread
+    u64 steps = 0;
+
+    Trainer(TrainOptions const& options);
+
+    /// @brief Run a single minibatch and optimizer step, returns the summed loss of the positions.
+    f64 train_batch(const PackedPosition* const* positions, u32 count);
+
+    /// @brief Train on the given positions for options.epochs epochs, shuffled every epoch.
+    void train(const PackedPosition* data, u64 count, std::function<void(EpochStats const&)> report = nullptr);
+};
+
+/// @brief Load the network file at the given path the way the engine does and compare its evaluation of the
+/// given positions with the float network, returns false if the file is not accepted by nnue::Network::load.
+bool check_export(const FloatNetwork* network, const char* path, const PackedPosition* positions, u64 count, u32 threads, ExportCheck* out);
+
+/// @brief Generate the given amount of random positions, for benchmarking.
+void random_positions(PackedPosition* out, u64 count, u64 seed);
+
+}
\ No newline at end of file
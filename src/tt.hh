@@ -4,6 +4,7 @@
 #include "bitboard.hh"
 #include "move.hh"
 #include "board.hh"
+#include "evaldef.hh"
 
 namespace tc {
 
@@ -17,10 +18,12 @@ enum TTEntryType {
 
 /// @brief An entry in the transposition table
 struct TTEntry {
-    // PositionHash hash;
+    u32 key;   // The upper 32 bits of the position hash, used to verify hits
     TTEntryType type;
     u8 depth;  // The depth at which this entry was added/evaluated
+    u8 generation; // The search this entry was added in, entries of earlier searches are replaced first
     i32 score; // The ABSOLUTE evaluation at this depth
+    i32 staticEval; // The ABSOLUTE static evaluation of the position, or NULL_EVAL if unknown
     union {
         Move move; // The best move in this position, as determined by the search, only available when type == EXACT
     } data;
@@ -35,23 +38,29 @@ struct TranspositionTable {
     u64 capacity = 0;  // Must be a power of 2
     u32 indexMask = 0; // Computed from power of 2 capacity
     u64 used = 0;
+    u8 generation = 0; // Incremented for every search so entries are kept warm between them
 
     void alloc(u32 powerOf2);
+    void clear();
+    forceinline void new_search() { generation++; }
     inline u64 index(Board* board);
-    inline TTEntry* add(Board* board, TTEntryType type, i32 depth, i32 eval, /* should be removed if unused bc inlined */ bool* overwritten);
+    inline TTEntry* add(Board* board, TTEntryType type, i32 depth, i32 eval, i32 staticEval, /* should be removed if unused bc inlined */ bool* overwritten);
     inline TTEntry* get(Board* board);
 };
 
+#define TT_KEY(hash) ((u32)((hash) >> 32))
+
 forceinline u64 TranspositionTable::index(Board* board) {
     PositionHash hash = board->zhash();
     return hash & indexMask;
 }
 
-forceinline TTEntry* TranspositionTable::add(Board* board, TTEntryType type, i32 depth, i32 eval, /* should be removed if unused bc inlined */ bool* overwritten) {
-    TTEntry* entry = &data[index(board)];
+forceinline TTEntry* TranspositionTable::add(Board* board, TTEntryType type, i32 depth, i32 eval, i32 staticEval, /* should be removed if unused bc inlined */ bool* overwritten) {
+    const PositionHash hash = board->zhash();
+    TTEntry* entry = &data[hash & indexMask];
     if (entry->type != TT_NULL) {
-        // check if we should overwrite this entry
-        bool overwrite = entry->depth <= depth;
+        // check if we should overwrite this entry, an entry left by an earlier search only takes up space
+        bool overwrite = entry->generation != generation || entry->depth <= depth;
         if (!overwrite) {
             return nullptr; // dont overwrite this
         }
@@ -61,14 +70,29 @@ forceinline TTEntry* TranspositionTable::add(Board* board, TTEntryType type, i32
         used++;
     }
 
+    // keep the known static eval if the entry is for the same position
+    if (staticEval == NULL_EVAL && entry->type != TT_NULL && entry->key == TT_KEY(hash)) {
+        staticEval = entry->staticEval;
+    }
+
+    entry->key = TT_KEY(hash);
     entry->type = type;
     entry->depth = (i16)depth;
+    entry->generation = generation;
     entry->score = eval;
+    entry->staticEval = staticEval;
     return entry;
 }
 
+/// @brief Get the entry for the given position, or nullptr if the slot holds another position.
 inline TTEntry* TranspositionTable::get(Board* board) {
-    return &data[index(board)];
+    const PositionHash hash = board->zhash();
+    TTEntry* entry = &data[hash & indexMask];
+    if (entry->type == TT_NULL || entry->key != TT_KEY(hash)) {
+        return nullptr;
+    }
+
+    return entry;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,487 @@
+#include "tuner.hh"
+#include "basiceval.hh"
+#include "packedpos.hh"
+#include "logging.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace tc::tuner {
+
+static const i16* mgTablePerType[] = { pst::pawnMg, pst::knightMg, pst::bishopMg, pst::rookMg, pst::queenMg, pst::kingMg };
+static const i16* egTablePerType[] = { pst::pawnEg, pst::knightEg, pst::bishopEg, pst::rookEg, pst::queenEg, pst::kingEg };
+
+/* ------------- Feature Extraction ------------- */
+
+/// @brief Sums the feature counts of a single position, only the touched terms are reset afterwards.
+struct FeatureCollector {
+    i16 counts[TERM_COUNT] = { };
+    u16 touched[TERM_COUNT];
+    u16 touchedCount = 0;
+
+    forceinline void add(u16 term, i16 count) {
+        if (counts[term] == 0) {
+            touched[touchedCount++] = term;
+        }
+
+        counts[term] += count;
+    }
+
+    // move the non-zero counts into the given list and reset, returns the amount written
+    u8 flush(std::vector<Feature>* out) {
+        u8 n = 0;
+        for (u16 i = 0; i < touchedCount; i++) {
+            const u16 term = touched[i];
+            if (counts[term] != 0) {
+                out->push_back({ term, counts[term] });
+                counts[term] = 0;
+                n++;
+            }
+        }
+
+        touchedCount = 0;
+        return n;
+    }
+};
+
+// the same terms as PawnTerm, counted instead of weighted
+static void collect_pawn_features(Board* board, FeatureCollector* collector) {
+    for (Color color : { WHITE, BLACK }) {
+        const i16 sign = SIGN_OF_COLOR(color);
+        const Bitboard pawns = board->pieces(color, PAWN);
+        const Bitboard enemyPawns = board->pieces(!color, PAWN);
+
+        for (u8 file = 0; file < 8; file++) {
+            const u8 count = _popcount64(pawns & BITBOARD_FILE_MASK(file));
+            if (count == 0) {
+                continue;
+            }
+
+            const Bitboard adjacentFiles = (file > 0 ? BITBOARD_FILE_MASK(file - 1) : 0) | (file < 7 ? BITBOARD_FILE_MASK(file + 1) : 0);
+            if (count > 1) collector->add(TERM_DOUBLED_PAWN, sign * (count - 1));
+            if ((pawns & adjacentFiles) == 0) collector->add(TERM_ISOLATED_PAWN, sign * count);
+        }
+
+        Bitboard bb = pawns;
+        while (bb) {
+            const Sq sq = _pop_lsb(bb);
+            const u8 file = FILE(sq);
+            const Bitboard files = BITBOARD_FILE_MASK(file) | (file > 0 ? BITBOARD_FILE_MASK(file - 1) : 0) | (file < 7 ? BITBOARD_FILE_MASK(file + 1) : 0);
+            const Bitboard ahead = color ? (BITBOARD_FULL_MASK << 8 << (RANK(sq) * 8)) : ((1ULL << (RANK(sq) * 8)) - 1);
+            if ((enemyPawns & files & ahead) == 0) {
+                collector->add(TERM_PASSED_PAWN + (color ? RANK(sq) : 7 - RANK(sq)), sign);
+            }
+        }
+    }
+}
+
+// the same terms as MobilityTerm, counted instead of weighted
+static void collect_mobility_features(Board* board, FeatureCollector* collector) {
+    const AttackMap* attacks = board->attack_map();
+    for (Color color : { WHITE, BLACK }) {
+        const i16 sign = SIGN_OF_COLOR(color);
+        for (u8 pt = KNIGHT; pt <= QUEEN; pt++) {
+            if (attacks->mobility[color][pt]) collector->add(TERM_MOBILITY + pt, sign * attacks->mobility[color][pt]);
+        }
+
+        const Bitboard hanging = board->pieces(color, KNIGHT, BISHOP, ROOK, QUEEN) & attacks->all[!color] & ~attacks->all[color];
+        if (hanging) collector->add(TERM_HANGING_PIECE, sign * _popcount64(hanging));
+    }
+}
+
+/// @brief Per thread state for parsing the positions of a block.
+struct Extractor {
+    Board board;
+    MaterialTable<13> materialTable;
+    KingSafetyTerm kingSafety;
+    FeatureCollector collector;
+    u64 skipped = 0;
+
+    // find the game result in the rest of the line, returns false if there is none
+    static bool parse_result(const char* p, const char* end, u8* result) {
+        const std::string_view rest(p, end - p);
+        if (rest.find("1/2-1/2") != std::string_view::npos || rest.find("[0.5]") != std::string_view::npos) { *result = PACKED_RESULT_DRAW; return true; }
+        if (rest.find("1-0") != std::string_view::npos || rest.find("[1.0]") != std::string_view::npos) { *result = PACKED_RESULT_WIN; return true; }
+        if (rest.find("0-1") != std::string_view::npos || rest.find("[0.0]") != std::string_view::npos) { *result = PACKED_RESULT_LOSS; return true; }
+        return false;
+    }
+
+    void extract_line(const char* p, const char* end, Dataset::Block* block) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p == end) {
+            return;
+        }
+
+        u8 result;
+        p = board.parse_fen(p, end);
+        if (p == nullptr || !parse_result(p, end, &result)) {
+            skipped++;
+            return;
+        }
+
+        MaterialEntry* material = materialTable.probe(&board);
+        if (material->has_eval_func()) {
+            skipped++;
+            return;
+        }
+
+        for (u8 pt = PAWN; pt <= QUEEN; pt++) {
+            const i16 diff = board.count(WHITE, (PieceType)pt) - board.count(BLACK, (PieceType)pt);
+            if (diff) collector.add(TERM_MATERIAL + pt, diff);
+        }
+
+        const i16 bishopPairs = (board.count(WHITE, BISHOP) >= 2) - (board.count(BLACK, BISHOP) >= 2);
+        if (bishopPairs) collector.add(TERM_BISHOP_PAIR, bishopPairs);
+
+        // the tables are laid out from the 8th rank down, black uses the vertically mirrored square
+        Bitboard bb = board.all_pieces();
+        while (bb) {
+            const Sq sq = _pop_lsb(bb);
+            const Piece p = board.piece_on(sq);
+            const u8 index = IS_WHITE_PIECE(p) ? (7 - RANK(sq)) * 8 + FILE(sq) : RANK(sq) * 8 + FILE(sq);
+            collector.add(TERM_PST + TYPE_OF_PIECE(p) * 64 + index, SIGN_OF_COLOR(IS_WHITE_PIECE(p)));
+        }
+
+        collect_pawn_features(&board, &collector);
+        collect_mobility_features(&board, &collector);
+
+        // the king safety is not linear, it is kept as a constant offset
+        EvalContext ctx { .board = &board };
+        kingSafety.evaluate(&ctx);
+
+        Entry entry;
+        entry.phase = MIN(board.game_phase(), PHASE_MAX);
+        entry.base = pst::taper(ctx.score, entry.phase) / (f32)iEval(0.01);
+        entry.result = result;
+        entry.featureCount = collector.flush(&block->features);
+        block->entries.push_back(entry);
+    }
+};
+
+bool Dataset::load(const char* path, u32 threads) {
+    MappedFile file;
+    if (!file.map(path)) {
+        return false;
+    }
+
+    // split the file into blocks at line boundaries
+    std::vector<u64> starts;
+    for (u64 pos = 0; pos < file.size;) {
+        starts.push_back(pos);
+        pos = MIN(pos + TUNER_BLOCK_SIZE, file.size);
+        while (pos < file.size && file.data[pos - 1] != '\n') pos++;
+    }
+
+    starts.push_back(file.size);
+    blocks.clear();
+    blocks.resize(starts.size() - 1);
+
+    std::atomic<u64> skippedTotal = 0;
+    parallel_for(blocks.size(), threads, 1, [&](u64 begin, u64 end) {
+        thread_local Extractor extractor;
+        extractor.skipped = 0;
+        for (u64 i = begin; i < end; i++) {
+            const char* p = (const char*)file.data + starts[i];
+            const char* blockEnd = (const char*)file.data + starts[i + 1];
+            while (p < blockEnd) {
+                const char* lineEnd = (const char*)memchr(p, '\n', blockEnd - p);
+                if (lineEnd == nullptr) lineEnd = blockEnd;
+                extractor.extract_line(p, lineEnd, &blocks[i]);
+                p = lineEnd + 1;
+            }
+
+            blocks[i].entries.shrink_to_fit();
+            blocks[i].features.shrink_to_fit();
+        }
+
+        skippedTotal += extractor.skipped;
+    });
+
+    file.unmap();
+
+    positions = features = 0;
+    for (Block const& block : blocks) {
+        positions += block.entries.size();
+        features += block.features.size();
+    }
+
+    skipped = skippedTotal;
+    return true;
+}
+
+u64 Dataset::memory() const {
+    return positions * sizeof(Entry) + features * sizeof(Feature);
+}
+
+/* ------------- Parameters ------------- */
+
+Params Params::current() {
+    Params params;
+    memset(&params, 0, sizeof(params));
+
+    const i32 valuePerType[] = { evalValuePawn, evalValueKnight, evalValueBishop, evalValueRook, evalValueQueen };
+    for (u8 pt = PAWN; pt <= QUEEN; pt++) {
+        params.values[TERM_MATERIAL + pt][0] = params.values[TERM_MATERIAL + pt][1] = valuePerType[pt] / (double)iEval(0.01);
+    }
+
+    params.values[TERM_BISHOP_PAIR][0] = params.values[TERM_BISHOP_PAIR][1] = evalBishopPair / (double)iEval(0.01);
+
+    auto setScore = [&](u16 term, Score score) {
+        params.values[term][0] = mg_value(score);
+        params.values[term][1] = eg_value(score);
+    };
+
+    for (u8 pt = PAWN; pt <= KING; pt++) {
+        for (u8 i = 0; i < 64; i++) {
+            params.values[TERM_PST + pt * 64 + i][0] = mgTablePerType[pt][i];
+            params.values[TERM_PST + pt * 64 + i][1] = egTablePerType[pt][i];
+        }
+
+        setScore(TERM_MOBILITY + pt, mobilityWeightPerType[pt]);
+    }
+
+    setScore(TERM_HANGING_PIECE, hangingPieceWeight);
+    setScore(TERM_DOUBLED_PAWN, doubledPawnWeight);
+    setScore(TERM_ISOLATED_PAWN, isolatedPawnWeight);
+    for (u8 rank = 0; rank < 8; rank++) {
+        setScore(TERM_PASSED_PAWN + rank, passedPawnWeightPerRank[rank]);
+    }
+
+    return params;
+}
+
+bool Params::write_header(const char* path) const {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    auto value = [&](u16 term, u8 i) { return (i32)std::lround(values[term][i]); };
+    auto score = [&](u16 term) { return "make_score(" + std::to_string(value(term, 0)) + ", " + std::to_string(value(term, 1)) + ")"; };
+
+    file << "#pragma once\n\n#include \"types.hh\"\n#include \"evaldef.hh\"\n\n"
+            "/*\n"
+            "    The tunable evaluation parameters. This file can be regenerated by the tuner (see\n"
+            "    tuner.hh), which writes the tuned values back in exactly this layout.\n"
+            " */\n\n"
+            "namespace tc {\n\n"
+            "// Material Values\n";
+
+    const char* materialNames[] = { "evalValuePawn  ", "evalValueKnight", "evalValueBishop", "evalValueRook  ", "evalValueQueen " };
+    for (u8 pt = PAWN; pt <= QUEEN; pt++) {
+        file << "constexpr i32 " << materialNames[pt] << " = " << value(TERM_MATERIAL + pt, 0) << " * iEval(0.01);\n";
+    }
+
+    file << "\nconstexpr i32 evalBishopPair = " << value(TERM_BISHOP_PAIR, 0) << " * iEval(0.01);\n\n"
+            "/* Evaluation weights, in centipawns */\n\n"
+            "/// @brief The score per safe square a piece of the given type attacks\n"
+            "constexpr Score mobilityWeightPerType[] = { ";
+    for (u8 pt = PAWN; pt <= KING; pt++) {
+        file << score(TERM_MOBILITY + pt) << (pt < KING ? ", " : " };\n\n");
+    }
+
+    file << "/// @brief The score per piece attacked by the enemy and not defended\n"
+            "constexpr Score hangingPieceWeight = " << score(TERM_HANGING_PIECE) << ";\n\n"
+            "constexpr Score doubledPawnWeight = " << score(TERM_DOUBLED_PAWN) << ";\n"
+            "constexpr Score isolatedPawnWeight = " << score(TERM_ISOLATED_PAWN) << ";\n\n"
+            "/// @brief The bonus for a passed pawn per rank relative to its color\n"
+            "constexpr Score passedPawnWeightPerRank[] = { ";
+    for (u8 rank = 0; rank < 8; rank++) {
+        file << score(TERM_PASSED_PAWN + rank) << (rank == 7 ? " };\n\n}\n\n" : rank == 3 ? ",\n                                              " : ", ");
+    }
+
+    file << "namespace tc::pst {\n\n"
+            "/* Base tables in centipawns from the perspective of white, laid out as seen\n"
+            "   on the board, so the first row is the 8th rank. */\n";
+
+    const char* typeNames[] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+    for (u8 pt = PAWN; pt <= KING; pt++) {
+        for (u8 i = 0; i < 2; i++) {
+            file << "\nconstexpr i16 " << typeNames[pt] << (i ? "Eg" : "Mg") << "[64] = {\n";
+            for (u8 row = 0; row < 8; row++) {
+                file << "    ";
+                for (u8 col = 0; col < 8; col++) {
+                    file << (col ? " " : "") << std::setw(3) << value(TERM_PST + pt * 64 + row * 8 + col, i) << (row == 7 && col == 7 ? "" : ",");
+                }
+
+                file << "\n";
+            }
+
+            file << "};\n";
+        }
+    }
+
+    file << "\n}";
+    return (bool)file;
+}
+
+/* ------------- Optimization ------------- */
+
+// all of the optimization is done in double, the extended precision f64 is much slower
+constexpr double ln10 = 2.302585092994046;
+
+// the evaluation in centipawns, for the sigmoid
+static forceinline double evaluate(const Entry& entry, const Feature* features, const Params& params) {
+    double mg = 0, eg = 0, flat = entry.base;
+    for (u8 i = 0; i < entry.featureCount; i++) {
+        const Feature f = features[i];
+        if (f.term < TERM_FLAT_COUNT) {
+            flat += f.count * params.values[f.term][0];
+        } else {
+            mg += f.count * params.values[f.term][0];
+            eg += f.count * params.values[f.term][1];
+        }
+    }
+
+    return flat + (mg * entry.phase + eg * (PHASE_MAX - entry.phase)) / PHASE_MAX;
+}
+
+// the sigmoid of an evaluation in centipawns, the expected score for white
+static forceinline double sigmoid(double eval, double scaling) {
+    return 1.0 / (1.0 + std::exp(-scaling * eval * (ln10 / 400.0)));
+}
+
+static forceinline double result_score(u8 result) {
+    return result * 0.5;
+}
+
+/// @brief Call fn(block) for every block in parallel and sum the returned value.
+template<typename F>
+static double sum_blocks(const Dataset& data, u32 threads, F&& fn) {
+    std::mutex mutex;
+    double total = 0;
+    parallel_for(data.blocks.size(), threads, 1, [&](u64 begin, u64 end) {
+        for (u64 i = begin; i < end; i++) {
+            const double sum = fn(data.blocks[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            total += sum;
+        }
+    });
+
+    return total;
+}
+
+double loss(const Dataset& data, const Params& params, double scaling, u32 threads) {
+    const double total = sum_blocks(data, threads, [&](const Dataset::Block& block) {
+        double sum = 0;
+        const Feature* features = block.features.data();
+        for (const Entry& entry : block.entries) {
+            const double error = result_score(entry.result) - sigmoid(evaluate(entry, features, params), scaling);
+            sum += error * error;
+            features += entry.featureCount;
+        }
+
+        return sum;
+    });
+
+    return total / MAX(data.positions, 1ULL);
+}
+
+double fit_scaling(const Dataset& data, const Params& params, u32 threads) {
+    // golden section search, the loss is unimodal in the scaling
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double lo = 0.05, hi = 4.0;
+    double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+    double lossA = loss(data, params, a, threads), lossB = loss(data, params, b, threads);
+    while (hi - lo > 1e-4) {
+        if (lossA < lossB) {
+            hi = b; b = a; lossB = lossA;
+            a = hi - ratio * (hi - lo);
+            lossA = loss(data, params, a, threads);
+        } else {
+            lo = a; a = b; lossA = lossB;
+            b = lo + ratio * (hi - lo);
+            lossB = loss(data, params, b, threads);
+        }
+    }
+
+    return (lo + hi) / 2;
+}
+
+void tune(const Dataset& data, Params* params, TuneOptions const& options, TuneStats* stats,
+          std::function<void(u32 epoch, double loss)> report) {
+    constexpr double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    const auto start = std::chrono::steady_clock::now();
+
+    const double scaling = options.scaling > 0 ? options.scaling : fit_scaling(data, *params, options.threads);
+    const double sigmoidScale = scaling * (ln10 / 400.0);
+
+    stats->initialLoss = loss(data, *params, scaling, options.threads);
+
+    std::vector<double> gradient(TERM_COUNT * 2), m(TERM_COUNT * 2, 0), v(TERM_COUNT * 2, 0);
+    for (u32 epoch = 1; epoch <= options.epochs; epoch++) {
+        std::fill(gradient.begin(), gradient.end(), 0);
+
+        // full batch gradient, accumulated per block and merged under the lock
+        std::mutex mutex;
+        double lossSum = 0;
+        parallel_for(data.blocks.size(), options.threads, 1, [&](u64 begin, u64 end) {
+            double local[TERM_COUNT][2];
+            for (u64 b = begin; b < end; b++) {
+                const Dataset::Block& block = data.blocks[b];
+                memset(local, 0, sizeof(local));
+
+                double localLoss = 0;
+                const Feature* features = block.features.data();
+                for (const Entry& entry : block.entries) {
+                    const double s = sigmoid(evaluate(entry, features, *params), scaling);
+                    const double error = result_score(entry.result) - s;
+                    localLoss += error * error;
+
+                    // derivative of the squared error by the evaluation
+                    const double d = -2 * error * s * (1 - s) * sigmoidScale;
+                    const double mgFactor = d * entry.phase / PHASE_MAX, egFactor = d - mgFactor;
+                    for (u8 i = 0; i < entry.featureCount; i++) {
+                        const Feature f = features[i];
+                        if (f.term < TERM_FLAT_COUNT) {
+                            local[f.term][0] += d * f.count;
+                        } else {
+                            local[f.term][0] += mgFactor * f.count;
+                            local[f.term][1] += egFactor * f.count;
+                        }
+                    }
+
+                    features += entry.featureCount;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                lossSum += localLoss;
+                for (u32 i = 0; i < TERM_COUNT * 2; i++) {
+                    gradient[i] += (&local[0][0])[i];
+                }
+            }
+        });
+
+        const double currentLoss = lossSum / MAX(data.positions, 1ULL);
+
+        // Adam, terms without any gradient such as pawns on the back ranks are left untouched
+        const double correction1 = 1 - std::pow(beta1, epoch), correction2 = 1 - std::pow(beta2, epoch);
+        for (u32 i = 0; i < TERM_COUNT * 2; i++) {
+            const double g = gradient[i] / data.positions;
+            m[i] = beta1 * m[i] + (1 - beta1) * g;
+            v[i] = beta2 * v[i] + (1 - beta2) * g * g;
+            if (v[i] > 0) {
+                (&params->values[0][0])[i] -= options.learningRate * (m[i] / correction1) / (std::sqrt(v[i] / correction2) + epsilon);
+            }
+        }
+
+        for (u16 term = 0; term < TERM_FLAT_COUNT; term++) {
+            params->values[term][1] = params->values[term][0];
+        }
+
+        if (report && options.reportEvery && epoch % options.reportEvery == 0) {
+            report(epoch, currentLoss);
+        }
+    }
+
+    stats->scaling = scaling;
+    stats->epochs = options.epochs;
+    stats->loss = loss(data, *params, scaling, options.threads);
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "types.hh"
+#include "platform.hh"
+#include "piece.hh"
+
+/*
+    Texel tuning of the linear evaluation parameters in evalparams.hh against game results.
+
+    The EPD file is memory mapped and parsed in parallel blocks, each position is reduced once to
+    a sparse list of (term, count) features with the white count minus the black count, together
+    with its game phase and the untuned part of the evaluation. The linear evaluation of a position
+    is then just a dot product with the parameters, so full batch Adam over the whole dataset on
+    the mean squared error of the sigmoid of the evaluation against the game result takes a single
+    pass over the features per epoch. Positions finished by a specialised endgame evaluation are
+    skipped, as they are not affected by the parameters.
+
+    Each line holds a FEN (the move counters are optional) followed by the result of the game as
+    1-0, 0-1 or 1/2-1/2 (optionally quoted, like in a c9 opcode) or as [1.0], [0.5] or [0.0].
+ */
+
+namespace tc::tuner {
+
+#define TUNER_BLOCK_SIZE (1 << 20) // bytes of the EPD file parsed per block
+
+/// @brief The index of each tuned term, the middlegame and endgame value are tuned separately
+/// except for the terms below TERM_FLAT_COUNT which are not tapered.
+enum TermIndex : u16 {
+    TERM_MATERIAL      = 0,                      // per piece type from pawn to queen
+    TERM_BISHOP_PAIR   = TERM_MATERIAL + 5,
+    TERM_PST           = TERM_BISHOP_PAIR + 1,   // per piece type and index into its table
+    TERM_MOBILITY      = TERM_PST + 6 * 64,      // per piece type
+    TERM_HANGING_PIECE = TERM_MOBILITY + 6,
+    TERM_DOUBLED_PAWN,
+    TERM_ISOLATED_PAWN,
+    TERM_PASSED_PAWN,                            // per relative rank
+    TERM_COUNT         = TERM_PASSED_PAWN + 8
+};
+
+#define TERM_FLAT_COUNT TERM_PST
+
+struct Feature {
+    u16 term;
+    i16 count;
+};
+
+struct Entry {
+    f32 base;         // the ABSOLUTE evaluation of the untuned terms in centipawns
+    u8 phase;
+    u8 result;        // PACKED_RESULT_*
+    u8 featureCount;
+};
+
+/// @brief The extracted positions, in blocks as parsed from the file.
+struct Dataset {
+    struct Block {
+        std::vector<Entry> entries;
+        std::vector<Feature> features;
+    };
+
+    std::vector<Block> blocks;
+    u64 positions = 0;
+    u64 features = 0;
+    u64 skipped = 0; // lines which could not be parsed or positions with a specialised evaluation
+
+    /// @brief Map and parse the given EPD file, returns whether the file could be read.
+    bool load(const char* path, u32 threads);
+
+    u64 memory() const;
+};
+
+/// @brief The middlegame and endgame value of each term in centipawns.
+struct Params {
+    double values[TERM_COUNT][2];
+
+    /// @brief The current values from evalparams.hh.
+    static Params current();
+
+    /// @brief Write the parameters as a replacement for evalparams.hh.
+    bool write_header(const char* path) const;
+};
+
+struct TuneOptions {
+    u32 threads = 1;
+    u32 epochs = 400;
+    double learningRate = 1.0;
+    double scaling = 0;    // the K of the sigmoid, fitted to the starting parameters if zero
+    u32 reportEvery = 50;
+};
+
+struct TuneStats {
+    double scaling = 0;
+    double initialLoss = 0;
+    double loss = 0;
+    u32 epochs = 0;
+    double seconds = 0;
+};
+
+/// @brief The mean squared error of the sigmoid of the evaluations against the results.
+double loss(const Dataset& data, const Params& params, double scaling, u32 threads);
+
+/// @brief Find the scaling of the sigmoid which minimizes the loss of the given parameters.
+double fit_scaling(const Dataset& data, const Params& params, u32 threads);
+
+/// @brief Tune the given parameters with Adam, report is called every options.reportEvery epochs.
+void tune(const Dataset& data, Params* params, TuneOptions const& options, TuneStats* stats,
+          std::function<void(u32 epoch, double loss)> report = nullptr);
+
+}
\ No newline at end of file
@@ -13,6 +13,7 @@
 
 /* Base Types */
 typedef unsigned char u8;
+typedef signed char i8;
 typedef unsigned short u16;
 typedef signed short i16;
 typedef unsigned int u32;
@@ -2,8 +2,757 @@
 
 namespace tc {
 
+/// @brief Parse the whole given argument as a number, returns whether it is one.
+/// The output is only written if it is.
+template<typename T>
+static bool parse_number(std::string const& str, T* out) {
+    T value;
+    bool valid;
+    if constexpr (std::is_floating_point_v<T>) {
+        char* end = nullptr;
+        value = (T)std::strtod(str.c_str(), &end);
+        valid = !str.empty() && end == str.c_str() + str.size();
+    } else {
+        auto [ptr, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+        valid = error == std::errc() && ptr == str.data() + str.size();
+    }
+
+    if (valid) *out = value;
+    return valid;
+}
+
 void uci_newgame(UCIState* state) {
     state->board = Board();
+    state->keyHistory.clear();
+    state->board.set_key_history(&state->keyHistory);
+    state->positionFen.clear();
+    state->positionMoves.clear();
+
+    // only a new game forgets what was learned, the searches of a game share it
+    if (state->transpositionTable.data) {
+        state->transpositionTable.clear();
+    }
+
+    state->threadState.correctionHistory.clear();
+    state->threadState.continuationHistory->clear();
+    state->evaluator.cache.clear();
+    if (state->nnueEvaluator) {
+        state->nnueEvaluator->cache.clear();
+    }
+}
+
+void uci_setoption(UCIState* state, std::vector<std::string> const& args) {
+    // the name and value may contain spaces
+    std::string name, value;
+    std::string* current = nullptr;
+    for (u64 i = 1; i < args.size(); i++) {
+        if (args[i] == "name" && current == nullptr) { current = &name; continue; }
+        if (args[i] == "value" && current == &name) { current = &value; continue; }
+        if (current == nullptr) continue;
+
+        if (!current->empty()) *current += " ";
+        *current += args[i];
+    }
+
+    if (name == "SyzygyPath") {
+        const u32 count = syzygy::init(value);
+        std::cout << "info string Found " << count << " tablebases\n";
+        return;
+    }
+
+    if (name == "TablePath") {
+        state->tablePath = value == "<empty>" ? "" : value;
+        const u32 count = tbgen::init(state->tablePath);
+        std::cout << "info string Found " << count << " tables\n";
+        return;
+    }
+
+    if (name == "EvalFile") {
+        state->nnueEvaluator.reset();
+        state->network.unload();
+
+        // the scores of the table were found with the other evaluation
+        if (state->transpositionTable.data) {
+            state->transpositionTable.clear();
+        }
+
+        if (value.empty() || value == "<empty>") {
+            std::cout << "info string Using the classic evaluation\n";
+            return;
+        }
+
+        if (!state->network.load(value.c_str())) {
+            std::cout << "info string Invalid network " << value << ", using the classic evaluation\n";
+            return;
+        }
+
+        state->nnueEvaluator = std::make_unique<UCINNUEEvaluator>(&state->network);
+        std::cout << "info string Loaded network " << value << "\n";
+        return;
+    }
+
+    if (name == "MultiPV") {
+        u32 multiPV;
+        if (!parse_number(value, &multiPV)) {
+            std::cout << "info string Invalid value " << value << " for MultiPV\n";
+            return;
+        }
+
+        state->multiPV = (u8)std::clamp(multiPV, 1u, (u32)MAX_MULTI_PV);
+        return;
+    }
+
+    // the gui only tells whether it will send go ponder, nothing to prepare for it
+    if (name == "Ponder") {
+        return;
+    }
+
+    std::cout << "info string Unknown option " << name << "\n";
+}
+
+static void print_generation_stats(tbgen::GenerationStats const& s) {
+    std::cout << "info string " << s.name << ": " << s.positions << " positions (" << s.wins << " won, " << s.losses << " lost, " <<
+        s.draws << " drawn, " << s.invalid << " invalid), longest mate " << s.longestMate << " plies, " << s.iterations << " iterations, " <<
+        std::fixed << std::setprecision(2) << (double)s.seconds << "s, " << s.memory / (1024 * 1024) << " MiB memory, " << s.fileSize / 1024 << " KiB file\n";
+}
+
+/// @brief Generate our own endgame tables, `tbgen <material> [threads <n>] [dir <path>]`.
+/// `tbgen bench` generates KRPvKR and every table it depends on into a fresh directory and
+/// reports the total generation time and the peak memory used by table data.
+void uci_tbgen(UCIState* state, std::vector<std::string> const& args) {
+    if (args.size() < 2) {
+        std::cout << "usage: tbgen <material|bench> [threads <n>] [dir <path>]\n";
+        return;
+    }
+
+    const bool bench = args[1] == "bench";
+    u32 threads = MAX(std::thread::hardware_concurrency(), 1U);
+    std::string dir = bench ? "tbbench" : (state->tablePath.empty() ? "tables" : state->tablePath);
+    for (u64 i = 2; i + 1 < args.size(); i += 2) {
+        if (args[i] == "threads" && !parse_number(args[i + 1], &threads)) {
+            std::cout << "usage: tbgen <material|bench> [threads <n>] [dir <path>]\n";
+            return;
+        }
+
+        if (args[i] == "dir") dir = args[i + 1];
+    }
+
+    if (bench) {
+        std::error_code error;
+        std::filesystem::remove_all(dir, error);
+    }
+
+    const std::string material = bench ? "KRPvKR" : args[1];
+    std::vector<tbgen::GenerationStats> stats;
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = tbgen::generate(material, dir, threads, &stats);
+    const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    if (!ok) {
+        std::cout << "info string Failed to generate " << material << "\n";
+    }
+
+    u64 positions = 0, peakMemory = 0, fileSize = 0;
+    for (tbgen::GenerationStats const& s : stats) {
+        print_generation_stats(s);
+        positions += s.positions;
+        peakMemory = MAX(peakMemory, s.memory);
+        fileSize += s.fileSize;
+    }
+
+    std::cout << "info string Generated " << stats.size() << " tables with " << positions << " positions on " << threads << " threads in " <<
+        std::fixed << std::setprecision(2) << (double)seconds << "s, peak memory " << peakMemory / (1024 * 1024) << " MiB, " <<
+        fileSize / 1024 << " KiB on disk\n";
+
+    if (!bench && dir == state->tablePath) {
+        tbgen::init(state->tablePath);
+    }
+}
+
+/// @brief Tune the linear evaluation parameters on an EPD file with game results,
+/// `tune <file> [threads <n>] [epochs <n>] [lr <rate>] [k <scaling>] [out <path>]`.
+/// The tuned parameters are written as a replacement for evalparams.hh.
+void uci_tune(UCIState* state, std::vector<std::string> const& args) {
+    if (args.size() < 2) {
+        std::cout << "usage: tune <file> [threads <n>] [epochs <n>] [lr <rate>] [k <scaling>] [out <path>]\n";
+        return;
+    }
+
+    tuner::TuneOptions options;
+    options.threads = MAX(std::thread::hardware_concurrency(), 1U);
+    std::string out = "evalparams.hh";
+    for (u64 i = 2; i + 1 < args.size(); i += 2) {
+        bool valid = true;
+        if (args[i] == "threads") valid = parse_number(args[i + 1], &options.threads);
+        else if (args[i] == "epochs") valid = parse_number(args[i + 1], &options.epochs);
+        else if (args[i] == "lr") valid = parse_number(args[i + 1], &options.learningRate);
+        else if (args[i] == "k") valid = parse_number(args[i + 1], &options.scaling);
+        else if (args[i] == "out") out = args[i + 1];
+
+        if (!valid) {
+            std::cout << "usage: tune <file> [threads <n>] [epochs <n>] [lr <rate>] [k <scaling>] [out <path>]\n";
+            return;
+        }
+    }
+
+    tuner::Dataset data;
+    const auto start = std::chrono::steady_clock::now();
+    if (!data.load(args[1].c_str(), options.threads)) {
+        std::cout << "info string Failed to read " << args[1] << "\n";
+        return;
+    }
+
+    const double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "info string Loaded " << data.positions << " positions (" << data.skipped << " skipped) with " << data.features << " features in " <<
+        std::fixed << std::setprecision(2) << loadSeconds << "s, " << data.memory() / (1024 * 1024) << " MiB\n";
+
+    tuner::Params params = tuner::Params::current();
+    tuner::TuneStats stats;
+    tuner::tune(data, &params, options, &stats, [&](u32 epoch, double loss) {
+        std::cout << "info string Epoch " << epoch << " loss " << std::setprecision(6) << loss << "\n";
+    });
+
+    std::cout << "info string Tuned " << stats.epochs << " epochs on " << options.threads << " threads in " << std::setprecision(2) << stats.seconds <<
+        "s, k " << std::setprecision(4) << stats.scaling << ", loss " << std::setprecision(6) << stats.initialLoss << " -> " << stats.loss << "\n";
+
+    if (!params.write_header(out.c_str())) {
+        std::cout << "info string Failed to write " << out << "\n";
+        return;
+    }
+
+    std::cout << "info string Wrote " << out << "\n";
+}
+
+static const char* fenBenchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "2r3k1/1q3ppp/p3p3/1p1pP3/3P4/P2Q1N2/1P3PPP/2R3K1 b - - 3 27 bm Qc7; id \"epd\";",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - d6",
+};
+
+#define FENBENCH_EVAL_POSITIONS 1'000'000 // about the amount of evaluations each evaluator is timed with
+
+/// @brief Measure the fen parser, `fenbench [<epd file>] [iters <n>]`. Every line of the file, or a small
+/// built-in set of positions, is parsed the given amount of times through the pointer based parser and
+/// through the iterator based wrapper used by the text protocol. The valid positions are then evaluated
+/// one at a time and through the batch evaluators, by the network as well if one is loaded.
+void uci_fenbench(UCIState* state, std::vector<std::string> const& args) {
+    u32 iters = 0;
+    std::string path;
+    for (u64 i = 1; i < args.size(); i++) {
+        if (args[i] != "iters" || i + 1 >= args.size()) {
+            path = args[i];
+        } else if (!parse_number(args[++i], &iters)) {
+            std::cout << "usage: fenbench [<epd file>] [iters <n>]\n";
+            return;
+        }
+    }
+
+    // the lines are kept as views into the mapped file
+    MappedFile file;
+    std::vector<std::string_view> lines;
+    if (!path.empty()) {
+        if (!file.map(path.c_str())) {
+            std::cout << "info string Failed to read " << path << "\n";
+            return;
+        }
+
+        const char* p = (const char*)file.data;
+        const char* end = p + file.size;
+        while (p < end) {
+            const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+            if (lineEnd == nullptr) lineEnd = end;
+            if (lineEnd > p) lines.emplace_back(p, lineEnd - p);
+            p = lineEnd + 1;
+        }
+    } else {
+        for (const char* fen : fenBenchPositions) lines.emplace_back(fen);
+    }
+
+    iters = iters > 0 ? iters : MAX((u32)(1'000'000 / MAX(lines.size(), (u64)1)), 1u);
+
+    Board board;
+    u64 invalid = 0, checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < iters; i++) {
+        for (std::string_view line : lines) {
+            if (board.parse_fen(line.data(), line.data() + line.size()) == nullptr) {
+                invalid++;
+                continue;
+            }
+
+            checksum += board.zhash();
+        }
+    }
+
+    const f64 parseSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    // the iterator based wrapper needs a stream per line like the input loop builds it
+    start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < iters; i++) {
+        for (std::string_view line : lines) {
+            std::istringstream iss { std::string(line) };
+            std::noskipws(iss);
+            std::istream_iterator<char> it(iss);
+            board.load_fen(it, std::istream_iterator<char>());
+        }
+    }
+
+    const f64 streamSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    const u64 count = (u64)iters * lines.size();
+    std::cout << "info string Parsed " << count << " positions (" << invalid << " invalid, checksum " << std::hex << checksum << std::dec << "), " <<
+        std::fixed << std::setprecision(1) << parseSeconds * 1e9 / MAX(count, (u64)1) << " ns per position, " <<
+        streamSeconds * 1e9 / MAX(count, (u64)1) << " ns through the stream wrapper\n";
+
+    std::vector<PackedPosition> positions;
+    for (std::string_view line : lines) {
+        if (board.parse_fen(line.data(), line.data() + line.size()) != nullptr) {
+            positions.emplace_back();
+            pack_position(&board, &positions.back());
+        }
+    }
+
+    if (positions.empty()) {
+        return;
+    }
+
+    // single threaded, the batches only differ in how the positions are evaluated
+    const u64 n = positions.size();
+    const u32 evalIters = MAX((u32)(FENBENCH_EVAL_POSITIONS / n), 1u);
+    std::vector<i32> evals(n);
+    auto ns_per_position = [&](auto&& evaluate) {
+        const auto begin = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < evalIters; i++) evaluate();
+        return std::chrono::duration<f64>(std::chrono::steady_clock::now() - begin).count() * 1e9 / ((u64)evalIters * n);
+    };
+
+    auto evaluator = std::make_unique<BasicStaticEvaluator>();
+    const f64 singleNs = ns_per_position([&]() {
+        for (u64 i = 0; i < n; i++) {
+            unpack_position(&positions[i], &board);
+            evals[i] = evaluator->eval(&board);
+        }
+    });
+
+    const f64 staticNs = ns_per_position([&]() { batch::eval_static<BasicStaticEvaluator>(positions.data(), n, evals.data(), 1); });
+    const f64 linearNs = ns_per_position([&]() { batch::eval_linear(positions.data(), n, evals.data(), 1); });
+    std::cout << "info string Evaluated " << (u64)evalIters * n << " positions, static " << std::fixed << std::setprecision(1) << singleNs <<
+        " ns single, " << staticNs << " ns batched, linear terms " << linearNs << " ns batched\n";
+
+    if (state->network.loaded()) {
+        auto nnueEvaluator = std::make_unique<NNUEEvaluator>(&state->network);
+        const f64 nnueSingleNs = ns_per_position([&]() {
+            for (u64 i = 0; i < n; i++) {
+                unpack_position(&positions[i], &board);
+                evals[i] = nnueEvaluator->eval(&board);
+            }
+        });
+
+        const f64 nnueNs = ns_per_position([&]() { batch::eval_nnue(&state->network, positions.data(), n, evals.data(), 1); });
+        std::cout << "info string Network " << std::fixed << std::setprecision(1) << nnueSingleNs << " ns single, " << nnueNs << " ns batched\n";
+    }
+}
+
+/// @brief Find the legal move given in long algebraic notation, or NULL_MOVE if there is none.
+template<bool turn>
+Move uci_find_move(Board& b, std::string const& str) {
+    if (str.length() < 4) {
+        return NULL_MOVE;
+    }
+
+    const Sq src = sq_str_to_index(str.c_str());
+    const Sq dst = sq_str_to_index(str.c_str() + 2);
+    const PieceType promotion = str.length() > 4 ? charToPieceType(str[4]) : NULL_PIECE_TYPE;
+
+    MoveList<NoOrderMoveOrderer, MAX_MOVES> moveList;
+    gen_all_moves<decltype(moveList), movegenAllPL, turn>(&b, &moveList);
+    for (int i = moveList.count - 1; i >= 0; i--) {
+        Move move = moveList.get_move(i);
+        if (move.null() || !move.eq_sd(src, dst) || move.promotion_piece() != promotion) continue;
+
+        ExtMove<true> extMove(move);
+        b.make_move_unchecked<turn, true>(&extMove);
+
+        // check legal
+        const bool legal = !b.is_in_check<turn>();
+        b.unmake_move_unchecked<turn, true>(&extMove);
+        return legal ? move : NULL_MOVE;
+    }
+
+    return NULL_MOVE;
+}
+
+Move uci_find_move_dyn(Board& b, std::string const& str) {
+    if (b.turn) return uci_find_move<WHITE>(b, str);
+    else        return uci_find_move<BLACK>(b, str);
+}
+
+/// @brief Make the legal move given in long algebraic notation, keeping it on the board.
+bool uci_make_move_dyn(Board& b, std::string const& str) {
+    const Move move = uci_find_move_dyn(b, str);
+    if (move.null()) {
+        return false;
+    }
+
+    ExtMove<true> extMove(move);
+    if (b.turn) b.make_move_unchecked<WHITE, true>(&extMove);
+    else        b.make_move_unchecked<BLACK, true>(&extMove);
+    return true;
+}
+
+/// @brief Set up the position of `position [startpos | fen <fen> | <fen>] [moves <move>...]`.
+/// GUIs send the whole game on every move, so when the position starts from the same fen and the
+/// moves extend the ones played before only the new moves are made on the current board.
+void uci_position(UCIState* state, std::vector<std::string> const& args) {
+    auto moves = std::find(args.begin(), args.end(), "moves");
+    auto fenBegin = args.begin() + 1;
+    if (fenBegin != args.end() && *fenBegin == "fen") fenBegin++;
+
+    std::string fen;
+    for (auto f = fenBegin; f != moves; f++) {
+        if (!fen.empty()) fen += ' ';
+        fen += *f;
+    }
+
+    if (fen.empty() || fen == "startpos") {
+        fen = startFEN;
+    }
+
+    // the moves already on the board have to be a prefix of the new ones
+    const u64 moveCount = moves != args.end() ? args.end() - moves - 1 : 0;
+    const bool extends = fen == state->positionFen && state->positionMoves.size() <= moveCount &&
+        std::equal(state->positionMoves.begin(), state->positionMoves.end(), moves + 1);
+
+    if (!extends) {
+        state->board = Board();
+        if (!state->board.load_fen(fen)) {
+            std::cout << "info string Invalid fen " << fen << "\n";
+            state->board.load_fen(startFEN);
+            fen = startFEN;
+        }
+
+        state->keyHistory.clear();
+        state->board.set_key_history(&state->keyHistory);
+        state->positionFen = fen;
+        state->positionMoves.clear();
+    }
+
+    // play the new moves of the game, recording the keys of the positions in between
+    for (u64 i = state->positionMoves.size(); i < moveCount; i++) {
+        std::string const& move = *(moves + 1 + i);
+        if (!uci_make_move_dyn(state->board, move)) {
+            std::cout << "info string Illegal move " << move << "\n";
+            break;
+        }
+
+        state->positionMoves.push_back(move);
+    }
+}
+
+static void write_uci_move(std::ostream& os, Move move) {
+    if (move.null()) {
+        os << "0000";
+        return;
+    }
+
+    os << FILE_TO_CHAR(FILE(move.src)) << RANK_TO_CHAR(RANK(move.src));
+    os << FILE_TO_CHAR(FILE(move.dst)) << RANK_TO_CHAR(RANK(move.dst));
+    if (move.is_promotion()) os << typeToCharLowercase[move.promotion_piece()];
+}
+
+/// @brief Write the eval RELATIVE to the side to move in centipawns, or the moves until mate.
+static void write_uci_score(std::ostream& os, i32 eval) {
+    if (IS_MATE_EVAL(eval)) {
+        const i32 plies = COUNT_MATE_IN_PLY(eval);
+        os << "mate " << (eval > 0 ? (plies + 1) / 2 : -(plies / 2));
+        return;
+    }
+
+    os << "cp " << (i64)eval * 100 / EVAL_SCALE;
+}
+
+/// @brief Parse the limits of `go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>]
+/// [movetime <ms>] [depth <n>] [nodes <n>] [infinite] [ponder] [searchmoves <move>...]`.
+/// The searchmoves are collected into the given list, they run until the next keyword.
+static SearchLimits uci_parse_go(std::vector<std::string> const& args, Board& board, std::vector<Move>* searchMoves) {
+    SearchLimits limits;
+    bool inSearchMoves = false;
+    for (u64 i = 1; i < args.size(); i++) {
+        if (args[i] == "searchmoves") { inSearchMoves = true; continue; }
+        if (inSearchMoves) {
+            const Move move = uci_find_move_dyn(board, args[i]);
+            if (!move.null()) { searchMoves->push_back(move); continue; }
+            inSearchMoves = false;
+        }
+
+        if (args[i] == "infinite") { limits.infinite = true; continue; }
+        if (args[i] == "ponder") { limits.ponder = true; continue; }
+        if (i + 1 >= args.size()) break;
+
+        // a malformed value leaves the limit unset
+        bool valid = true;
+        if (args[i] == "wtime") valid = parse_number(args[++i], &limits.time[WHITE]);
+        else if (args[i] == "btime") valid = parse_number(args[++i], &limits.time[BLACK]);
+        else if (args[i] == "winc") valid = parse_number(args[++i], &limits.inc[WHITE]);
+        else if (args[i] == "binc") valid = parse_number(args[++i], &limits.inc[BLACK]);
+        else if (args[i] == "movestogo") valid = parse_number(args[++i], &limits.movesToGo);
+        else if (args[i] == "movetime") valid = parse_number(args[++i], &limits.moveTime);
+        else if (args[i] == "depth") valid = parse_number(args[++i], &limits.depth);
+        else if (args[i] == "nodes") valid = parse_number(args[++i], &limits.nodes);
+
+        if (!valid) {
+            std::cout << "info string Invalid value " << args[i] << " for " << args[i - 1] << "\n";
+        }
+    }
+
+    return limits;
+}
+
+#define UCI_MAX_PV_LENGTH 32
+
+template<bool turn, typename _Evaluator>
+void uci_go_search(UCIState* state, _Evaluator* evaluator, SearchLimits const& limits, std::vector<Move> const& searchMoves) {
+    IterativeSearchState<uciSearchOptions, _Evaluator> iterState;
+    iterState.searchState.board = &state->board;
+    iterState.searchState.leafEval = evaluator;
+    iterState.searchState.transpositionTable = &state->transpositionTable;
+    iterState.searchState.timeManager = &state->timeManager;
+    iterState.searchState.stopSignal = &state->stopSignal;
+    iterState.multiPV = state->multiPV;
+    for (u64 i = 0; i < MIN(searchMoves.size(), (u64)MAX_MOVES); i++) {
+        iterState.searchState.rootMoves[iterState.searchState.rootMoveCount++] = searchMoves[i];
+    }
+
+    const u32 maxDepth = limits.depth > 0 ? limits.depth : MAX_DEPTH;
+    Move pv[UCI_MAX_PV_LENGTH];
+    u32 pvLength = 0;
+    search_iterative<uciSearchOptions, _Evaluator, turn>(&iterState, &state->threadState, maxDepth, [&](auto* it) {
+        const i64 elapsed = state->timeManager.elapsed();
+        const u64 nodes = it->searchState.nodes;
+        const TranspositionTable& tt = state->transpositionTable;
+
+        // written at once so the lines are not interleaved with the output of the input thread
+        std::ostringstream oss;
+        for (u8 line = 0; line < it->lineCount; line++) {
+            Move linePv[UCI_MAX_PV_LENGTH];
+            const u32 linePvLength = search_collect_pv<turn>(&state->transpositionTable, &state->board, it->lineMoves[line], linePv, 0, UCI_MAX_PV_LENGTH);
+            if (line == 0) {
+                std::copy(linePv, linePv + linePvLength, pv);
+                pvLength = linePvLength;
+            }
+
+            oss << "info depth " << it->completedDepth << " multipv " << line + 1 << " score ";
+            write_uci_score(oss, it->lineEvals[line]);
+            oss << " nodes " << nodes << " nps " << nodes * 1000 / MAX(elapsed, (i64)1) << " hashfull " << MIN(tt.used * 1000 / (tt.indexMask + 1ULL), 1000ULL) <<
+                " time " << elapsed << " pv";
+            for (u32 i = 0; i < linePvLength; i++) {
+                oss << " ";
+                write_uci_move(oss, linePv[i]);
+            }
+
+            oss << "\n";
+        }
+
+        std::cout << oss.str() << std::flush;
+    });
+
+    // the best move may only be reported once the gui ends an infinite or ponder search
+    while ((limits.infinite || state->timeManager.pondering.load(std::memory_order_acquire)) &&
+           !state->stopSignal.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    // the reply we expect is pondered on while the opponent thinks
+    std::ostringstream oss;
+    oss << "bestmove ";
+    write_uci_move(oss, iterState.bestMove);
+    if (pvLength >= 2) {
+        oss << " ponder ";
+        write_uci_move(oss, pv[1]);
+    }
+
+    oss << "\n";
+    std::cout << oss.str() << std::flush;
+}
+
+/// @brief Abort the running search, if any, and wait for it to report its best move.
+void uci_stop_search(UCIState* state) {
+    if (state->searchThread.joinable()) {
+        state->stopSignal.store(true, std::memory_order_relaxed);
+        state->searchThread.join();
+    }
+}
+
+/// @brief Start searching the current position within the given limits on the search thread,
+/// the best move is reported by it once the limits are reached or the search is stopped.
+void uci_go(UCIState* state, std::vector<std::string> const& args) {
+    uci_stop_search(state);
+
+    std::vector<Move> searchMoves;
+    const SearchLimits limits = uci_parse_go(args, state->board, &searchMoves);
+    if (!state->transpositionTable.data) {
+        state->transpositionTable.alloc(UCI_TT_SIZE_BITS);
+    }
+
+    state->transpositionTable.new_search();
+    state->timeManager.init(limits, state->board.turn);
+    state->stopSignal.store(false, std::memory_order_relaxed);
+    state->searchThread = std::thread([state, limits, searchMoves]() {
+        if (state->nnueEvaluator) {
+            // the accumulators follow the board through the search
+            state->nnueEvaluator->evaluator.attach(&state->board);
+            if (state->board.turn) uci_go_search<WHITE>(state, state->nnueEvaluator.get(), limits, searchMoves);
+            else                   uci_go_search<BLACK>(state, state->nnueEvaluator.get(), limits, searchMoves);
+            state->nnueEvaluator->evaluator.detach();
+        } else {
+            if (state->board.turn) uci_go_search<WHITE>(state, &state->evaluator, limits, searchMoves);
+            else                   uci_go_search<BLACK>(state, &state->evaluator, limits, searchMoves);
+        }
+    });
+}
+
+// a fixed mix of openings, middlegames and endgames, changing it changes the bench signature
+static const char* benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 3 54",
+    "2r2rk1/1bqnbpp1/1p1ppn1p/pP6/N1P1P3/P2B1N1P/1B2QPP1/R2R2K1 b - - 1 20",
+    "rnbqkb1r/ppp1pppp/5n2/3p4/3P4/2N5/PPP1PPPP/R1BQKBNR w KQkq - 2 3",
+    "r3k2r/pppq1ppp/2n1bn2/2bpp3/4P3/2NP1N2/PPPBBPPP/R2QK2R w KQkq - 4 8",
+    "r1b1k2r/ppppnppp/2n2q2/2b5/3NP3/2P1B3/PP3PPP/RN1QKB1R w KQkq - 0 7",
+    "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 12",
+    "1nk1r1r1/pp2n1pp/4p3/q2pPp1N/b1pP1P2/B1P2R2/2P1B1PP/R2Q2K1 w - - 0 18",
+    "2kr1bnr/pbpq4/2n1pp2/3p3p/3P1P1B/2N2N1Q/PPP3PP/2KR1B1R w - - 0 13",
+    "3rr1k1/pp3pp1/1qn2np1/8/3p4/PP1R1P2/2P1NQPP/R1B3K1 b - - 0 21",
+    "2r1nrk1/p2q1ppp/bp1p4/n1pPp3/P1P1P3/2PBB1N1/4QPPP/R4RK1 w - - 0 17",
+    "r1bqkb1r/4npp1/p1p4p/1p1pP1B1/8/1B6/PPPN1PPP/R2Q1RK1 w kq - 0 11",
+    "r2q1rk1/1ppnbppp/p2p1nb1/3Pp3/2P1P1P1/2N2N1P/PPB1QP2/R1B2RK1 b - - 0 14",
+    "r1bq1rk1/pp2ppbp/2np2p1/2n5/P3PP2/N1P2N2/1PB3PP/R1B1QRK1 b - - 0 11",
+    "3rr3/2pq2pk/p2p1pnp/8/2QBPP2/1P6/P5PP/4RRK1 b - - 0 24",
+    "r4k2/pb2bp1r/1p1qp2p/3pNp2/3P1P2/2N3P1/PPP1Q2P/2KRR3 w - - 0 19",
+    "3rn2k/ppb2rpp/2ppqp2/5N2/2P1P3/1P5Q/PB3PPP/3RR1K1 w - - 0 22",
+    "r1bqk2r/pp2bppp/2p5/3pP3/P2Q1P2/2N1B3/1PP3PP/R4RK1 b kq - 0 12",
+    "r2qnrnk/p2b2b1/1p1p2pp/2pPpp2/1PP1P3/PRNBB3/3QNPPP/5RK1 w - - 0 20",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 33",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 27",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 35",
+    "2r3k1/pppR1pp1/4p3/4P1P1/5P2/1P4K1/P1P5/8 w - - 0 30",
+    "4b3/p3kp2/6p1/3pP2p/2pP1P2/4K1P1/P3N2P/8 w - - 0 38",
+    "8/8/4kpp1/3p1b2/p6P/2B5/6P1/6K1 b - - 2 48",
+    "6k1/p3pp2/1p1p3p/3P4/2P5/1P5P/P5P1/6K1 w - - 0 30",
+    "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 0 45",
+    "8/8/8/1p1k4/1P6/2K5/8/8 w - - 0 50",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 60",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 70",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 80",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 56",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 58",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 62",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+};
+
+#define BENCH_DEPTH 8
+#define BENCH_HASH  16 // the MiB of the transposition table of each thread
+
+/// @brief Search the fixed bench suite to a fixed depth, `bench [depth] [threads] [hash]`.
+/// Every position starts from an empty transposition table and history, so the total node count
+/// only depends on the engine and is printed as its signature. The positions are spread over the
+/// threads, each searching one position at a time with its own table of the given MiB.
+void uci_bench(UCIState* state, std::vector<std::string> const& args) {
+    u32 depth = BENCH_DEPTH, threads = 1;
+    u64 hash = BENCH_HASH;
+    if ((args.size() > 1 && !parse_number(args[1], &depth)) || (args.size() > 2 && !parse_number(args[2], &threads)) ||
+        (args.size() > 3 && !parse_number(args[3], &hash))) {
+        std::cout << "usage: bench [depth] [threads] [hash]\n";
+        return;
+    }
+
+    depth = std::clamp(depth, 1u, (u32)MAX_DEPTH / 2);
+    threads = MAX(threads, 1u);
+    hash = MAX(hash, (u64)1);
+
+    u32 tableBits = 10;
+    while (tableBits < 30 && (2ULL << (tableBits + 1)) * sizeof(TTEntry) <= hash * 1024 * 1024) tableBits++;
+
+    constexpr u32 positionCount = sizeof(benchPositions) / sizeof(benchPositions[0]);
+    std::vector<u64> nodes(positionCount, 0);
+    std::vector<Move> bestMoves(positionCount, NULL_MOVE);
+    std::atomic<u32> next = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto worker = [&]() {
+        TranspositionTable tt;
+        tt.alloc(tableBits);
+        ThreadSearchState<uciSearchOptions> threadState;
+        UCIEvaluator evaluator;
+        KeyHistory keyHistory;
+
+        for (u32 i; (i = next.fetch_add(1, std::memory_order_relaxed)) < positionCount; ) {
+            tt.clear();
+            threadState.correctionHistory.clear();
+            threadState.continuationHistory->clear();
+            keyHistory.clear();
+            evaluator.cache.clear();
+
+            Board board;
+            board.load_fen(benchPositions[i]);
+            board.set_key_history(&keyHistory);
+
+            IterativeSearchState<uciSearchOptions, UCIEvaluator> iterState;
+            iterState.searchState.board = &board;
+            iterState.searchState.leafEval = &evaluator;
+            iterState.searchState.transpositionTable = &tt;
+            if (board.turn) search_iterative<uciSearchOptions, UCIEvaluator, WHITE>(&iterState, &threadState, depth, [](auto*) { });
+            else            search_iterative<uciSearchOptions, UCIEvaluator, BLACK>(&iterState, &threadState, depth, [](auto*) { });
+
+            nodes[i] = iterState.searchState.nodes;
+            bestMoves[i] = iterState.bestMove;
+        }
+
+        free(tt.data);
+    };
+
+    std::vector<std::thread> pool;
+    for (u32 i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    const i64 elapsed = MAX((i64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(), (i64)1);
+
+    u64 totalNodes = 0;
+    std::ostringstream oss;
+    for (u32 i = 0; i < positionCount; i++) {
+        totalNodes += nodes[i];
+        oss << "info string Position " << i + 1 << "/" << positionCount << " bestmove ";
+        write_uci_move(oss, bestMoves[i]);
+        oss << " nodes " << nodes[i] << "\n";
+    }
+
+    oss << "info string Bench depth " << depth << " threads " << threads << " hash " << hash << ": " << totalNodes << " nodes " <<
+        elapsed << " ms " << totalNodes * 1000 / elapsed << " nps\n";
+    std::cout << oss.str() << std::flush;
 }
 
 struct PerftStats {
@@ -112,7 +861,10 @@ void uci_listen(UCIState* state, OptionParser* opt) {
     
     /* Interface/UCI Main Loop */
     while (state->run) {
-        std::cout << "> ";
+        if (!state->uci) {
+            std::cout << "> ";
+        }
+
         std::string str;
         std::getline(std::cin, str);
 
@@ -133,6 +885,11 @@ void uci_listen(UCIState* state, OptionParser* opt) {
 
         // uci: uci
         if (cmd == "uci") {
+            std::cout << "option name SyzygyPath type string default <empty>\n";
+            std::cout << "option name TablePath type string default <empty>\n";
+            std::cout << "option name Ponder type check default false\n";
+            std::cout << "option name EvalFile type string default <empty>\n";
+            std::cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MULTI_PV << "\n";
             std::cout << "uciok\n";
             state->uci = true;
             continue;
@@ -147,6 +904,14 @@ void uci_listen(UCIState* state, OptionParser* opt) {
             continue;
         }
 
+        // uci: setoption name <id> [value <x>]
+        if (cmd == "setoption") {
+            // options are only changed while no search runs, the tablebases may be mapped anew
+            uci_stop_search(state);
+            uci_setoption(state, args);
+            continue;
+        }
+
         // uci: isready
         if (cmd == "isready") {
             std::cout << "readyok\n";
@@ -154,24 +919,70 @@ void uci_listen(UCIState* state, OptionParser* opt) {
 
         // uci: ucinewgame
         if (cmd == "ucinewgame") {
+            uci_stop_search(state);
             uci_newgame(state);
         }
 
         // uci: exit, e, quit, q
         if (cmd == "exit" || cmd == "e" || cmd == "quit" || cmd == "q") {
+            uci_stop_search(state);
             log<DEBUG>(P, "Calling OS exit(0)");
             exit(0);
         }
 
         // uci: position
         if (cmd == "position" || cmd == "pos" || cmd == "p") {
-            state->board.load_fen(it, end);
-            debug_tostr_board(std::cout, state->board);
+            uci_stop_search(state);
+            uci_position(state, args);
+
+            if (!state->uci) {
+                debug_tostr_board(std::cout, state->board);
+            }
+        }
+
+        // uci: go
+        if (cmd == "go") {
+            uci_go(state, args);
+        }
+
+        // uci: stop
+        if (cmd == "stop") {
+            uci_stop_search(state);
+        }
+
+        // uci: ponderhit
+        if (cmd == "ponderhit") {
+            state->timeManager.ponderhit();
+        }
+
+        // tbgen <material|bench> [threads <n>] [dir <path>]
+        if (cmd == "tbgen") {
+            uci_stop_search(state);
+            uci_tbgen(state, args);
+        }
+
+        // bench [depth] [threads] [hash]
+        if (cmd == "bench") {
+            uci_stop_search(state);
+            uci_bench(state, args);
+        }
+
+        // fenbench [<epd file>] [iters <n>]
+        if (cmd == "fenbench") {
+            uci_stop_search(state);
+            uci_fenbench(state, args);
+        }
+
+        // tune <file> [threads <n>] [epochs <n>] [lr <rate>] [k <scaling>] [out <path>]
+        if (cmd == "tune") {
+            uci_stop_search(state);
+            uci_tune(state, args);
         }
 
         // uci: perft
         if (cmd == "perft") {
             int depth = parse_int(it, end);
+            uci_stop_search(state);
             perft_root_print_dyn(state->board, depth);
         }
     }
@@ -6,6 +6,13 @@
 #include <sys/time.h>
 #include <io.h>
 #include <fcntl.h>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <charconv>
 
 #include "util.hh"
 #include "logging.hh"
@@ -13,6 +20,12 @@
 #include "board.hh"
 #include "search.hh"
 #include "basiceval.hh"
+#include "nnueeval.hh"
+#include "batcheval.hh"
+#include "syzygy.hh"
+#include "tbgen.hh"
+#include "tuner.hh"
+#include "timeman.hh"
 
 #include "../vendor/popl/include/popl.hpp"
 
@@ -20,14 +33,52 @@ using namespace popl;
 
 namespace tc {
 
+#define UCI_TT_SIZE_BITS 20 // the transposition table size as a power of 2, allocated on the first search
+
+inline constexpr StaticSearchOptions uciSearchOptions { .useTranspositionTable = true, .debugMetrics = false };
+
+#define UCI_EVAL_CACHE_BITS 12 // the eval cache size as a power of 2, kept small enough to stay in the L2 cache
+
+/// @brief The static evaluator of the searches, each search thread owns one so the cache needs no synchronization
+typedef CachedEvaluator<BasicStaticEvaluator, UCI_EVAL_CACHE_BITS> UCIEvaluator;
+typedef CachedEvaluator<NNUEEvaluator, UCI_EVAL_CACHE_BITS> UCINNUEEvaluator;
+
 struct UCIState {
     bool run = true;  // Whether to run the engine
     bool uci = false; // Whether UCI has been initialized
     bool debug = false;
 
+    std::string tablePath; // the directory of our own endgame tables, empty if not set
+    u8 multiPV = 1;        // the amount of best lines reported
+
     Board board;
+
+    /// @brief The keys of the positions of the game before the current one, attached to the board
+    KeyHistory keyHistory;
+
+    /// @brief The fen and the moves the current board was set up from by the last position command
+    std::string positionFen;
+    std::vector<std::string> positionMoves;
+
+    /// @brief The transposition table and histories are kept between the searches of a game,
+    /// so a ponder search or the search of the last move warms them up for the next one
+    TranspositionTable transpositionTable;
+    ThreadSearchState<uciSearchOptions> threadState;
+    UCIEvaluator evaluator;
+
+    /// @brief The network loaded through the EvalFile option, the searches evaluate with it instead if it is set
+    nnue::Network network;
+    std::unique_ptr<UCINNUEEvaluator> nnueEvaluator;
+
+    /* Search, run on its own thread so the input stays responsive */
+    std::thread searchThread;
+    std::atomic<bool> stopSignal { false }; // Polled by the search on every node
+    TimeManager timeManager;
 };
 
+/* Search the fixed bench suite, `bench [depth] [threads] [hash]` */
+void uci_bench(UCIState* state, std::vector<std::string> const& args);
+
 /* Main UCI command loop */
 void uci_listen(UCIState* state, OptionParser* opt);
 
@@ -1,7 +1,84 @@
 #include "util.hh"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace tc {
 
+bool MappedFile::map(const char* path) {
+    unmap();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!ptr) {
+        return false;
+    }
+
+    size = fileSize.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    size = st.st_size;
+#endif
+
+    data = (const u8*)ptr;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (!data) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile((void*)data);
+#else
+    munmap((void*)data, size);
+#endif
+
+    data = nullptr;
+    size = 0;
+}
+
 std::vector<std::string> split_str_by_whitespace(std::string const &input) { 
     std::istringstream buffer(input);
     std::vector<std::string> ret;
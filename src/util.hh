@@ -5,12 +5,56 @@
 #include <sstream>
 #include <vector>
 #include <iterator>
+#include <atomic>
+#include <thread>
+
+#include "platform.hh"
 
 namespace tc {
 
 /* Splits a string by whitespace */
 std::vector<std::string> split_str_by_whitespace(std::string const &input);
 
+/// @brief A read-only memory mapped file.
+struct MappedFile {
+    const u8* data = nullptr;
+    u64 size = 0;
+
+    /// @brief Map the file at the given path into memory, returns whether it succeeded.
+    bool map(const char* path);
+    void unmap();
+
+    forceinline bool mapped() const { return data != nullptr; }
+};
+
+/// @brief Call fn(begin, end) over chunks of [0, count) on the given amount of threads. The chunks are
+/// handed out dynamically so uneven work is balanced, with a single thread everything runs on the caller.
+template<typename F>
+void parallel_for(u64 count, u32 threads, u64 chunkSize, F&& fn) {
+    std::atomic<u64> next = 0;
+    auto worker = [&]() {
+        for (;;) {
+            const u64 begin = next.fetch_add(chunkSize, std::memory_order_relaxed);
+            if (begin >= count) return;
+            fn(begin, MIN(begin + chunkSize, count));
+        }
+    };
+
+    if (threads <= 1) {
+        worker();
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    for (u32 i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
 inline void skip_whitespace(std::istream_iterator<char>& it) {
     while (*it == ' ' || *it == '\t') {
         it++;
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include "../vendor/popl/include/popl.hpp"
+
+#include "logging.hh"
+#include "util.hh"
+#include "trainer.hh"
+
+using namespace popl;
+using namespace tc;
+
+/*
+    Standalone NNUE trainer, trains a network on files of PackedPosition records and
+    writes it in the format loaded by the engine. The written file is read back through
+    nnue::Network::load and its evaluations compared with the float network.
+
+    tensiontrain [options] <positions file>
+    tensiontrain --bench [--threads <n>]
+ */
+
+static void print_epoch(trainer::EpochStats const& s, u32 threads) {
+    std::cout << "epoch " << s.epoch << " loss " << std::setprecision(6) << (double)s.loss << " " << std::fixed << std::setprecision(2) <<
+        (double)s.seconds << "s " << (u64)s.positions_per_second() << " pos/s (" << (u64)(s.positions_per_second() / threads) << " pos/s per core)\n" <<
+        std::defaultfloat;
+}
+
+/// @brief Measure the training throughput on random positions with 1 thread and the given amount of threads.
+static void bench(trainer::TrainOptions options, u64 count) {
+    std::vector<PackedPosition> positions(count);
+    trainer::random_positions(positions.data(), count, options.seed);
+
+    const u32 maxThreads = options.threads;
+    options.epochs = 1;
+    for (u32 threads : { 1U, maxThreads }) {
+        options.threads = threads;
+        trainer::Trainer session(options);
+        f64 rate = 0;
+        session.train(positions.data(), count, [&](trainer::EpochStats const& s) { rate = s.positions_per_second(); });
+
+        std::cout << "bench threads " << threads << ": " << (u64)rate << " pos/s, " << (u64)(rate / threads) << " pos/s per core\n";
+        if (maxThreads == 1) break;
+    }
+}
+
+int main(int argc, char** argv) {
+    OptionParser opt("Tension NNUE trainer");
+
+    auto help = opt.add<Switch>("h", "help", "show this help");
+    auto out = opt.add<Value<std::string>>("o", "out", "the path to write the network to", "tension.nnue");
+    auto threads = opt.add<Value<u32>>("t", "threads", "the amount of threads", MAX(std::thread::hardware_concurrency(), 1U));
+    auto epochs = opt.add<Value<u32>>("e", "epochs", "the amount of passes over the positions", 10);
+    auto batchSize = opt.add<Value<u32>>("b", "batch", "the amount of positions per optimizer step", 16384);
+    auto learningRate = opt.add<Value<f32>>("l", "lr", "the Adam learning rate", 0.001f);
+    auto lambda = opt.add<Value<f32>>("", "lambda", "the weight of the search score against the game result", 0.5f);
+    auto scale = opt.add<Value<f32>>("", "scale", "the centipawns of the sigmoid", 400.0f);
+    auto seed = opt.add<Value<u64>>("", "seed", "the seed of the initialization and shuffling", 1);
+    auto doBench = opt.add<Switch>("", "bench", "measure the training throughput on random positions");
+    auto benchPositions = opt.add<Value<u64>>("", "bench-positions", "the amount of random positions to benchmark with", 1 << 18);
+
+    opt.parse(argc, argv);
+
+    if (help->is_set() || (!doBench->is_set() && opt.non_option_args().size() != 1)) {
+        std::cout << opt.help();
+        return help->is_set() ? 0 : 1;
+    }
+
+    trainer::TrainOptions options;
+    options.threads = MAX(threads->value(), 1U);
+    options.epochs = epochs->value();
+    options.batchSize = MAX(batchSize->value(), 1U);
+    options.learningRate = learningRate->value();
+    options.lambda = lambda->value();
+    options.evalScale = scale->value();
+    options.seed = seed->value();
+
+    if (doBench->is_set()) {
+        bench(options, benchPositions->value());
+        return 0;
+    }
+
+    const std::string& path = opt.non_option_args()[0];
+    MappedFile file;
+    if (!file.map(path.c_str()) || file.size % sizeof(PackedPosition) != 0) {
+        log<ERR>(P, "Could not read positions from %s", path.c_str());
+        return 1;
+    }
+
+    const u64 count = file.size / sizeof(PackedPosition);
+    std::cout << "training on " << count << " positions with " << options.threads << " threads\n";
+
+    trainer::Trainer session(options);
+    session.train((const PackedPosition*)file.data, count, [&](trainer::EpochStats const& s) {
+        print_epoch(s, options.threads);
+        if (!session.network->save(out->value().c_str())) {
+            log<ERR>(P, "Could not write the network to %s", out->value().c_str());
+        }
+    });
+
+    std::cout << "wrote " << out->value() << "\n";
+
+    // read the file back the way the engine does and compare it with the float network
+    trainer::ExportCheck check;
+    const u64 checkCount = MIN(count, (u64)TRAIN_EXPORT_CHECK_POSITIONS);
+    if (!trainer::check_export(session.network.get(), out->value().c_str(), (const PackedPosition*)file.data, checkCount, options.threads, &check)) {
+        log<ERR>(P, "The engine does not accept the network written to %s", out->value().c_str());
+        return 1;
+    }
+
+    std::cout << "export check " << check.positions << " positions: mean error " << std::fixed << std::setprecision(2) << (double)check.meanError <<
+        " cp, max error " << (double)check.maxError << " cp\n" << std::defaultfloat;
+    return 0;
+}
\ No newline at end of file